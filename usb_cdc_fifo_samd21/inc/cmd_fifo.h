@@ -7,24 +7,76 @@
 #include <stdbool.h>
 
 // Defines
-#define FIFO_MAX_NUM_CMDS 		8		    ///< Max number of commands to store in FIFO
-#define FIFO_MAX_CMD_SIZE 		16		    ///< Max size of FIFO command in bytes
+#define FIFO_LANE_HIGH_SIZE		128			///< Size of the high priority command lane byte ring, must be a power of two
+#define FIFO_LANE_NORMAL_SIZE	128			///< Size of the normal priority command lane byte ring, must be a power of two
+#define FIFO_MAX_CMD_SIZE 		62		    ///< Max size of FIFO command in bytes, a full size record must fit in half of each lane
+#define FIFO_RECORD_HDR_SIZE	1			///< Size of the length prefix stored in front of every item
+#define FIFO_RECORD_TERM_SIZE	1			///< Size of the null terminator stored after every item
+#define FIFO_RECORD_OVERHEAD	(FIFO_RECORD_HDR_SIZE + FIFO_RECORD_TERM_SIZE)	///< Bytes used by every item on top of its payload
+#define FIFO_RECORD_PAD			0xFF		///< Length prefix value that marks unused bytes at the end of the ring
 #define RESET_CHAR				0           ///< The value every byte in the buffer becomes on a reset
 
+#define FIFO_IS_POW2(x)			(((x) != 0) && (((x) & ((x) - 1)) == 0))	///< true if x is a power of two
+
+/// @brief  Statically allocates a FIFO and defines a handle called 'name' that points at it.
+/// The ring is 'depth' bytes and holds length-prefixed items of up to 'item_size' bytes, so
+/// it holds depth / (item_size + 2) full size items and more when they are shorter. 'depth'
+/// must be a power of two so wrap-around is a mask. A record never wraps, so an empty ring
+/// can only always take a full size record if 'depth' is at least twice the record: at any
+/// offset either the bytes up to the end or the bytes from the start are then big enough.
+/// Use FIFO_EXTERN(name) in other files.
+#define FIFO_DECLARE(name, depth, item_size)																\
+	_Static_assert(FIFO_IS_POW2(depth), #name ": FIFO depth must be a power of two");						\
+	_Static_assert((item_size) < FIFO_RECORD_PAD, #name ": FIFO item size must fit in the length prefix");	\
+	_Static_assert((2 * ((item_size) + FIFO_RECORD_OVERHEAD)) <= (depth), #name ": FIFO depth must be at least two full size records");	\
+	static uint8_t name##_storage[(depth)];																	\
+	static fifo_buf_t name##_buf = {name##_storage, (depth) - 1, (item_size), 0, 0, 0, 0, 0, 0};			\
+	fifo_handle_t name = &name##_buf
+
+#define FIFO_EXTERN(name)		extern fifo_handle_t name	///< declares a FIFO handle defined by FIFO_DECLARE in another file
+#define FIFO_HANDLE(name)		(&name##_buf)				///< constant handle of a FIFO declared in the same file, for static initializers
+
+/// @brief  enum containing the command priority lanes, highest priority first
+enum _fifo_lanes {
+	FIFO_LANE_HIGH = 0,
+	FIFO_LANE_NORMAL,
+	FIFO_NUM_LANES,
+};
+
+typedef enum _fifo_lanes fifo_lane_t;		///< typedef enum for user access to the command priority lanes
+
 // Structure Declarations
-typedef struct fifo_buf_t fifo_buf_t;       ///< Opaque FIFO buffer structure
+/// @brief FIFO buffer structure. Only public so FIFO_DECLARE can allocate it statically,
+/// use the API below to access it.
+struct fifo_buf_t{
+    uint8_t *buffer;		///< byte ring storage
+    uint32_t mask;			///< size of the byte ring - 1
+    uint32_t max_item;		///< largest item in bytes that can be pushed
+    uint32_t head;			///< free running read byte index, only written by the consumer
+    uint32_t tail;			///< free running write byte index, only written by the producer
+    uint32_t pushed;		///< number of records ever pushed, only written by the producer
+    uint32_t popped;		///< number of records ever popped, only written by the consumer
+    uint32_t reserved;		///< tail index of the record handed out by fifo_reserve, only written by the producer
+    uint32_t reserved_size;	///< number of bytes handed out by fifo_reserve, only written by the producer
+};
+
+typedef struct fifo_buf_t fifo_buf_t;       ///< FIFO buffer structure
 typedef fifo_buf_t *fifo_handle_t;          ///< This is a handle for users to interact w/ API
 
 // Function Declarations
-fifo_handle_t fifo_init(void);
-void fifo_free(fifo_handle_t fifo);
 void fifo_reset_all(fifo_handle_t fifo);
 void fifo_reset_item(fifo_handle_t fifo, uint8_t item_loc);
 bool fifo_push(fifo_handle_t fifo, uint8_t* item, size_t size);
 bool fifo_pop(fifo_handle_t fifo, uint8_t* item, size_t size);
+uint8_t* fifo_reserve(fifo_handle_t fifo, size_t size);
+uint8_t* fifo_extend(fifo_handle_t fifo, size_t size);
+bool fifo_commit(fifo_handle_t fifo, size_t size);
+uint8_t* fifo_peek(fifo_handle_t fifo, size_t* size);
+void fifo_release(fifo_handle_t fifo);
 uint8_t fifo_count(fifo_handle_t fifo);
 bool fifo_full(fifo_handle_t fifo);
 bool fifo_empty(fifo_handle_t fifo);
+fifo_handle_t fifo_lanes_next(const fifo_handle_t* lanes, uint8_t num_lanes);
 
 
 #endif /* CMD_FIFO_H_ */
@@ -9,6 +9,8 @@
 
 // User Includes
 #include "cmd_fifo.h"
+#include "registers.h"
+#include "task_sched.h"
 
 // Defines
 #define READ_REG_CMD		"rr"		///< string that represents the read register command 
@@ -19,11 +21,103 @@
 #define IDN_SIZE			5			///< size of the idn command in bytes
 #define STATUS_CMD			"sts?"		///< string that represents the status command 
 #define STATUS_SIZE			4			///< size of the status command in bytes
+#define BURST_READ_CMD		"br"		///< string that represents the burst register read command
+#define BURST_READ_SIZE		2			///< size of the burst register read command in bytes
+#define BURST_WRITE_CMD		"bw"		///< string that represents the burst register write command
+#define BURST_WRITE_SIZE	2			///< size of the burst register write command in bytes
+#define BURST_MAX_COUNT		128			///< max number of registers read by one burst read
+#define SNAPSHOT_CMD		"snap?"		///< string that represents the binary snapshot command
+#define SNAPSHOT_SIZE		5			///< size of the binary snapshot command in bytes
+#define SNAPSHOT_MARK		0x23		///< first byte of a binary snapshot frame ('#')
+#define BEGIN_CMD			"xbegin"	///< string that represents the register transaction begin command
+#define BEGIN_SIZE			6			///< size of the register transaction begin command in bytes
+#define COMMIT_CMD			"xcommit"	///< string that represents the register transaction commit command
+#define COMMIT_SIZE			7			///< size of the register transaction commit command in bytes
+#define ABORT_CMD			"xabort"	///< string that represents the register transaction abort command
+#define ABORT_SIZE			6			///< size of the register transaction abort command in bytes
+#define LATENCY_CMD			"lat?"		///< string that represents the latency histogram dump command
+#define LATENCY_SIZE		4			///< size of the latency histogram dump command in bytes
+#define LATENCY_CLEAR_CMD	"lclr"		///< string that represents the latency histogram reset command
+#define LATENCY_CLEAR_SIZE	4			///< size of the latency histogram reset command in bytes
+#define SUBSCRIBE_CMD		"sub"		///< string that represents the telemetry subscribe command
+#define SUBSCRIBE_SIZE		3			///< size of the telemetry subscribe command in bytes
+#define UNSUBSCRIBE_CMD		"unsub"		///< string that represents the telemetry unsubscribe command
+#define UNSUBSCRIBE_SIZE	5			///< size of the telemetry unsubscribe command in bytes
+#define LINE_TOO_LONG_CMD	"\x15"		///< queued by the usb framer in place of a line that was too long (ASCII NAK)
+#define LINE_TOO_LONG_SIZE	1			///< size of the line too long command in bytes
 #define INVALID_RET			0xFFFF		///< invalid response 
 #define INVALID_RET_SIZE	4			///< size of the invalid response in bytes
+#define STATUS_LINE_MAX_SIZE	26		///< longest sts? line, "RX Overflows:\t" + 10 decimal digits + "\r\n"
+#define STATUS_COUNTER_LINES	7		///< counter lines sts? prints after the registers, keep in step with command_status_request
+#define STATUS_REPLY_MAX_SIZE	(20 + ((REG_MAP_SIZE + STATUS_COUNTER_LINES) * STATUS_LINE_MAX_SIZE))	///< header line, one line per register and the counters
+#define CMD_REPLY_MAX_SIZE	STATUS_REPLY_MAX_SIZE	///< largest reply of one command queued on the transmit ring, streamed replies are not queued there
+#define CMD_BATCH_MAX		4			///< max number of command lines processed per pass of the main loop
+#define CMD_SEPARATOR		';'			///< separates several commands on one line
+#define CMD_MAX_ARGS		2			///< max number of hex arguments parsed for a command
+#define CMD_HASH_SIZE		32			///< number of slots in the command table, must be a power of two
+#define CMD_HASH(c0, c1)	(((c0) ^ ((c1) << 2)) & (CMD_HASH_SIZE - 1))	///< perfect hash of the first two characters of a command
+
+/// @brief command table, one line registers a command. The dispatcher and lane classifier
+/// are generated from it at build time. Columns are:
+/// X(token, size, first char, second char, handler, min args, max args, flags)
+/// The first two characters must hash to a free slot, a collision is a duplicate case
+/// label compile error in commands.c. A token shorter than two characters uses '\0'.
+#define COMMAND_TABLE(X) \
+	X(READ_REG_CMD,			READ_REG_SIZE,		'r',	'r',	command_read_reg,		1,	1,	CMD_FLAG_NONE) \
+	X(WRITE_REG_CMD,		WRITE_REG_SIZE,		'w',	'r',	command_write_reg,		2,	2,	CMD_FLAG_NONE) \
+	X(IDN_CMD,				IDN_SIZE,			'*',	'I',	command_idn_request,	0,	0,	CMD_FLAG_PRIORITY) \
+	X(STATUS_CMD,			STATUS_SIZE,		's',	't',	command_status_request,	0,	0,	CMD_FLAG_PRIORITY) \
+	X(BURST_READ_CMD,		BURST_READ_SIZE,	'b',	'r',	command_burst_read,		2,	2,	CMD_FLAG_STREAM) \
+	X(BURST_WRITE_CMD,		BURST_WRITE_SIZE,	'b',	'w',	command_burst_write,	2,	2,	CMD_FLAG_NONE) \
+	X(SNAPSHOT_CMD,			SNAPSHOT_SIZE,		's',	'n',	command_snapshot,		0,	0,	CMD_FLAG_STREAM) \
+	X(BEGIN_CMD,			BEGIN_SIZE,			'x',	'b',	command_begin,			0,	0,	CMD_FLAG_NONE) \
+	X(COMMIT_CMD,			COMMIT_SIZE,		'x',	'c',	command_commit,			0,	1,	CMD_FLAG_NONE) \
+	X(ABORT_CMD,			ABORT_SIZE,			'x',	'a',	command_abort,			0,	0,	CMD_FLAG_NONE) \
+	X(LATENCY_CMD,			LATENCY_SIZE,		'l',	'a',	command_latency,		0,	0,	CMD_FLAG_STREAM) \
+	X(LATENCY_CLEAR_CMD,	LATENCY_CLEAR_SIZE,	'l',	'c',	command_latency_clear,	0,	0,	CMD_FLAG_NONE) \
+	X(SUBSCRIBE_CMD,		SUBSCRIBE_SIZE,		's',	'u',	command_subscribe,		2,	2,	CMD_FLAG_NONE) \
+	X(UNSUBSCRIBE_CMD,		UNSUBSCRIBE_SIZE,	'u',	'n',	command_unsubscribe,	0,	0,	CMD_FLAG_NONE) \
+	X(LINE_TOO_LONG_CMD,	LINE_TOO_LONG_SIZE,	'\x15',	'\0',	command_invalid,		0,	0,	CMD_FLAG_NONE)
+
+/// @brief flags carried by each command table entry
+enum _command_flags{
+	CMD_FLAG_NONE		= 0x00,		///< no special handling
+	CMD_FLAG_PRIORITY	= 0x01,		///< queue in the high priority lane ahead of register traffic
+	CMD_FLAG_STREAM		= 0x02,		///< reply is streamed, held in the lane until the previous stream is sent. One per line.
+};
+
+/// @brief arguments parsed by the dispatcher before a handler is called
+struct _config_command_args{
+	uint32_t	value[CMD_MAX_ARGS];	///< hex arguments in the order they were sent
+	uint8_t		count;					///< number of arguments parsed
+	const char*	text;					///< rest of the command after the token, ends at CMD_SEPARATOR or null
+	const char*	end;					///< rest of the line after the last parsed argument
+};
+
+typedef void (*command_handler_t)(const struct _config_command_args* args);
+
+/// @brief one entry in the command table
+struct _config_command{
+	const char*			token;			///< command string, matched as a prefix of the line
+	uint8_t				size;			///< size of the token in bytes
+	uint8_t				min_args;		///< min number of hex arguments, fewer is answered as invalid
+	uint8_t				max_args;		///< max number of hex arguments parsed
+	uint8_t				flags;			///< bitwise or of command_flags_t
+	command_handler_t	handler;		///< function that handles the command
+};
+
+typedef enum _command_flags command_flags_t;				///< typedef enum for the command table flags
+typedef struct _config_command_args command_args_t;		///< typedef struct for the parsed command arguments
+typedef struct _config_command command_t;					///< typedef struct for a command table entry
+
+// Global Variables
+extern sched_task_t g_command_task;		///< frames received packets and runs commands, defined in main.c
 
 // Public Function Declarations
-void process_command(fifo_handle_t fifo);
+bool command_ready(const fifo_handle_t* lanes);
+bool process_command(const fifo_handle_t* lanes);
+uint8_t process_commands(const fifo_handle_t* lanes, uint8_t max_cmds);
+fifo_lane_t command_lane(const uint8_t* cmd, size_t size);
 
 
 #endif /* COMMANDS_H_ */
\ No newline at end of file
@@ -0,0 +1,19 @@
+/** 
+ * @file crc16.h
+ * @date 16.Oct.2026
+ * @brief Provides the CRC-16/CCITT-FALSE public function declarations
+ */
+#ifndef CRC16_H_
+#define CRC16_H_
+
+// System Libraries
+#include <stddef.h>
+#include <stdint.h>
+
+// Defines
+#define CRC16_INIT		0xFFFF		///< initial value of a CRC-16/CCITT-FALSE, polynomial 0x1021
+
+// Public Function Declarations
+uint16_t crc16_update(uint16_t crc, const uint8_t* buf, size_t len);
+
+#endif /* CRC16_H_ */
@@ -0,0 +1,21 @@
+/** 
+ * @file hex.h
+ * @date 16.Oct.2026
+ * @brief Provides the divide-free hex parse and format public function declarations
+ */
+#ifndef HEX_H_
+#define HEX_H_
+
+// System Libraries
+#include <stdint.h>
+
+// Defines
+#define HEX_MAX_DIGITS		8			///< max number of hex digits in a 32-bit value
+#define HEX_LINE_MAX_SIZE	12			///< size of the longest formatted line, "0xffffffff\r\n"
+
+// Public Function Declarations
+const char* hex_parse(const char* buf, uint32_t* value);
+uint8_t hex_format(char* buf, uint32_t value);
+uint8_t hex_format_line(char* buf, uint32_t value);
+
+#endif /* HEX_H_ */
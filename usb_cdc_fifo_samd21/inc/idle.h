@@ -0,0 +1,19 @@
+/** 
+ * @file idle.h
+ * @date 16.Oct.2026
+ * @brief Provides the main loop sleep public function declarations
+ */
+#ifndef IDLE_H_
+#define IDLE_H_
+
+// System Libraries
+#include <stdint.h>
+
+// Defines
+#define IDLE_SLEEP_MODE			0			///< SAMD21 IDLE0, only the cpu clock stops so USB keeps running and wake up takes a few clocks
+#define IDLE_MAX_SLEEP_MS		60			///< longest tickless sleep, must fit in a timebase alarm
+
+// Public Function Declarations
+void idle_task(void);
+
+#endif /* IDLE_H_ */
@@ -7,7 +7,16 @@
 #ifndef IRQ_H_
 #define IRQ_H_
 
+// System Libraries
+#include <stdbool.h>
+#include <stdint.h>
+
 // Public Function Declarations
 void irq_systick_init(void);
+uint32_t irq_systick_now(void);
+uint32_t irq_systick_ticks_since(uint32_t start);
+uint32_t irq_cycles_now(void);
+bool irq_systick_suspend(uint32_t* since_tick_us);
+void irq_systick_resume(uint32_t elapsed_us);
 
 #endif /* IRQ_H_ */
\ No newline at end of file
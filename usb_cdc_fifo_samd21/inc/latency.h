@@ -0,0 +1,40 @@
+/** 
+ * @file latency.h
+ * @date 16.Oct.2026
+ * @brief Provides the command latency histogram stages and public function declarations
+ */
+#ifndef LATENCY_H_
+#define LATENCY_H_
+
+// System Libraries
+#include <stddef.h>
+#include <stdint.h>
+
+// User Includes
+#include "cmd_fifo.h"
+
+// Defines
+#define LATENCY_NUM_BUCKETS		32			///< log2 buckets, bucket n counts latencies of 2^n to 2^(n+1)-1 cpu cycles
+#define LATENCY_DUMP_SIZE		(LAT_NUM_STAGES * (4 + LATENCY_NUM_BUCKETS * 16 + 2))	///< longest latency_format output
+
+/// @brief stages of a command's trip through the firmware, each has its own histogram
+enum _latency_stages{
+	LAT_STAGE_RX = 0,		///< packet received in the read callback to the command queued in its lane
+	LAT_STAGE_QUEUE,		///< queued in its lane to taken out by process_command
+	LAT_STAGE_DISPATCH,		///< taken out to every handler on the line returned
+	LAT_STAGE_TX,			///< handlers returned to the USB transfer with the last response byte completed
+	LAT_STAGE_TOTAL,		///< packet received to the USB transfer with the last response byte completed
+	LAT_NUM_STAGES
+};
+
+typedef enum _latency_stages latency_stage_t;		///< typedef enum for the latency stages
+
+// Public Function Declarations
+void latency_enqueue(fifo_lane_t lane, uint32_t rx_stamp);
+void latency_dequeue(fifo_lane_t lane, uint32_t tx_queued);
+void latency_dispatched(uint32_t tx_queued);
+void latency_tx_done(uint32_t tx_sent);
+void latency_reset(void);
+size_t latency_format(char* buf);
+
+#endif /* LATENCY_H_ */
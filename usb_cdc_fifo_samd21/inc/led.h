@@ -20,6 +20,7 @@ enum _led_states {
 typedef enum _led_states led_state_t;		///< typedef enum for user access to status led states
 
 // Public Function Declarations
+void led_init(void);
 void led_blink_status_led(void);
 
 #endif /* LED_H_ */
\ No newline at end of file
@@ -2,8 +2,8 @@
  * @file registers.h
  * @author John Petrilli
  * @date 25.July.2024
- * @brief Provides the position and mask for each variables stored in the status register,
- * struct to hold the individual values, struct to hold the registers
+ * @brief Provides the register map, the descriptor that describes each register, the struct
+ * that holds the register values, and the register access and transaction public function declarations
  */
 #ifndef REGISTERS_H_
 #define REGISTERS_H_
@@ -12,14 +12,72 @@
 #include <stdint.h>
 #include <stdbool.h>
 
-/// @brief struct that contains all the registers in the system
-struct _config_registers{
-	uint32_t register_01;
-	uint32_t register_02;
-	uint32_t register_03;
+// Defines
+/// @brief register map, one line adds a register. Columns are:
+/// X(number, name, width in bits, access, reset value, pre-write hook, post-read hook)
+/// Hooks are optional, pass NULL when the register is plain storage.
+#define REGISTER_MAP(X) \
+	X(0x01,	REG_01,	32,	REG_ACCESS_RW,	0x00000000,	NULL,	NULL) \
+	X(0x02,	REG_02,	32,	REG_ACCESS_RW,	0x00000000,	NULL,	NULL) \
+	X(0x03,	REG_03,	32,	REG_ACCESS_RW,	0x00000000,	NULL,	NULL)
+
+/// @brief access rights of a register
+enum _reg_access{
+	REG_ACCESS_NONE	= 0x00,		///< unused slot in the register map
+	REG_ACCESS_RO	= 0x01,		///< read only
+	REG_ACCESS_WO	= 0x02,		///< write only
+	REG_ACCESS_RW	= 0x03,		///< read and write
+};
+
+/// @brief register numbers generated from the register map
+enum _reg_numbers{
+#define REGISTER_NUMBER(number, name, width, access, reset, pre_write, post_read) name = (number),
+	REGISTER_MAP(REGISTER_NUMBER)
+#undef REGISTER_NUMBER
 };
 
+/// @brief one member per register, sized to its number plus one, so the size of the union is
+/// one more than the highest register number in the map
+union _reg_map_slots{
+#define REGISTER_SLOT(number, name, width, access, reset, pre_write, post_read) uint8_t name[(number) + 1];
+	REGISTER_MAP(REGISTER_SLOT)
+#undef REGISTER_SLOT
+};
+
+#define REG_MAP_SIZE		sizeof(union _reg_map_slots)	///< number of register slots, one more than the highest register number
+
+/// @brief called before a value is stored, may change the value or reject the write
+typedef bool (*reg_pre_write_t)(uint32_t reg, uint32_t* value);
+/// @brief called after a value is read, may change the value that is returned
+typedef void (*reg_post_read_t)(uint32_t reg, uint32_t* value);
 
+/// @brief struct that describes one register
+struct _config_register_desc{
+	uint8_t			width;			///< width of the register in bits, writes are masked to it
+	uint8_t			access;			///< bitwise or of reg_access_t
+	uint32_t		reset;			///< value loaded by registers_init
+	reg_pre_write_t	pre_write;		///< optional hook called before a write, NULL if unused
+	reg_post_read_t	post_read;		///< optional hook called after a read, NULL if unused
+};
+
+/// @brief struct that contains all the registers in the system, indexed by register number
+struct _config_registers{
+	uint32_t value[REG_MAP_SIZE];
+};
+
+typedef enum _reg_access reg_access_t;						///< typedef enum for the register access rights
+typedef struct _config_register_desc register_desc_t;		///< typedef struct for a register descriptor
 typedef struct _config_registers registers_t;				///< typedef struct for user access to the system registers
 
-#endif /* REGISTERS_H_ */
\ No newline at end of file
+// Public Function Declarations
+void registers_init(void);
+const register_desc_t* register_desc(uint32_t reg);
+bool register_read(uint32_t reg, uint32_t* value);
+bool register_write(uint32_t reg, uint32_t* value);
+bool registers_begin(void);
+bool registers_commit(bool on_tick, uint32_t* writes);
+bool registers_abort(uint32_t* writes);
+bool registers_tick(void);
+bool registers_tick_pending(void);
+
+#endif /* REGISTERS_H_ */
@@ -0,0 +1,46 @@
+/** 
+ * @file soft_timer.h
+ * @date 16.Oct.2026
+ * @brief Provides the hierarchical software timer wheel types and public function declarations
+ */
+#ifndef SOFT_TIMER_H_
+#define SOFT_TIMER_H_
+
+// System Libraries
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// User Includes
+#include "task_sched.h"
+
+// Defines
+#define SOFT_TIMER_SLOT_BITS	6			///< log2 of the number of slots in each wheel level
+#define SOFT_TIMER_LEVELS		3			///< wheel levels, each slot of a level spans a whole turn of the level below
+#define SOFT_TIMER_SLOTS		(1UL << SOFT_TIMER_SLOT_BITS)							///< slots in each level
+#define SOFT_TIMER_RANGE		(1UL << (SOFT_TIMER_SLOT_BITS * SOFT_TIMER_LEVELS))	///< furthest ahead in milli-seconds a timer can be placed directly, 262s
+
+/// @brief  static initializer for a timer that posts 'task' when it expires
+#define SOFT_TIMER_INIT(task_)		{ .next = NULL, .link = NULL, .expires = 0, .period = 0, .task = (task_) }
+
+/// @brief struct describing a timer. When it expires its task is posted to the scheduler, a
+/// periodic timer is re-armed first so its period does not drift.
+struct _config_soft_timer {
+	struct _config_soft_timer* next;	///< next timer in the same wheel slot
+	struct _config_soft_timer** link;	///< pointer that points at this timer, NULL when not armed
+	uint32_t expires;					///< board millis the timer expires
+	uint32_t period;					///< re-arm period in milli-seconds, 0 for a one-shot timer
+	sched_task_t* task;					///< task posted when the timer expires
+	uint8_t level;						///< wheel level the timer is in
+};
+
+typedef struct _config_soft_timer soft_timer_t;		///< typedef struct for user access to a timer
+
+// Public Function Declarations
+void soft_timer_arm(soft_timer_t* timer, uint32_t delay_ms, uint32_t period_ms);
+void soft_timer_cancel(soft_timer_t* timer);
+bool soft_timer_armed(const soft_timer_t* timer);
+void soft_timer_task(void);
+bool soft_timer_next(uint32_t* millis);
+
+#endif /* SOFT_TIMER_H_ */
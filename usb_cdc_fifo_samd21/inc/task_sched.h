@@ -0,0 +1,44 @@
+/** 
+ * @file task_sched.h
+ * @date 16.Oct.2026
+ * @brief Provides the cooperative run queue scheduler types and public function declarations
+ */
+#ifndef TASK_SCHED_H_
+#define TASK_SCHED_H_
+
+// System Libraries
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Defines
+/// @brief  static initializer for a task that runs 'handler' at 'priority'
+#define SCHED_TASK_INIT(handler_, priority_)	{ .next = NULL, .handler = (handler_), .priority = (priority_), .queued = false }
+
+/// @brief  enum containing the task priorities, highest first
+enum _sched_priority {
+	SCHED_PRIORITY_HIGH = 0,		///< host traffic, commands and the transmit flush
+	SCHED_PRIORITY_NORMAL,			///< periodic jobs such as telemetry
+	SCHED_PRIORITY_LOW,				///< housekeeping such as the status LED
+	SCHED_NUM_PRIORITIES,
+};
+
+typedef enum _sched_priority sched_priority_t;		///< typedef enum for user access to the task priorities
+
+/// @brief struct describing a task. A task is a handler that runs to completion each time
+/// it is posted, it is never preempted by another task.
+struct _config_sched_task {
+	struct _config_sched_task* next;	///< next task in the same run queue
+	void (*handler)(void);				///< runs the task once
+	sched_priority_t priority;			///< run queue the task is posted to
+	volatile bool queued;				///< true from sched_post until the handler is called
+};
+
+typedef struct _config_sched_task sched_task_t;		///< typedef struct for user access to a task
+
+// Public Function Declarations
+void sched_post(sched_task_t* task);
+bool sched_run(void);
+bool sched_pending(void);
+
+#endif /* TASK_SCHED_H_ */
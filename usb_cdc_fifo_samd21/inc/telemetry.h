@@ -0,0 +1,22 @@
+/** 
+ * @file telemetry.h
+ * @date 16.Oct.2026
+ * @brief Provides the periodic register telemetry public function declarations
+ */
+#ifndef TELEMETRY_H_
+#define TELEMETRY_H_
+
+// System Libraries
+#include <stdbool.h>
+#include <stdint.h>
+
+// Defines
+#define TELEMETRY_MAX_REGS		8			///< max number of registers in one subscription
+#define TELEMETRY_FRAME_MARK	'@'			///< first char of a pushed sample frame, never the first char of a command reply
+
+// Public Function Declarations
+bool telemetry_subscribe(uint32_t period_ms, const uint32_t* regs, uint8_t count);
+void telemetry_unsubscribe(void);
+void telemetry_task(void);
+
+#endif /* TELEMETRY_H_ */
@@ -0,0 +1,23 @@
+/** 
+ * @file timebase.h
+ * @date 16.Oct.2026
+ * @brief Provides the 64-bit micro-second timebase public function declarations
+ */
+#ifndef TIMEBASE_H_
+#define TIMEBASE_H_
+
+// System Libraries
+#include <stdint.h>
+
+// Defines
+#define TIMEBASE_TICK_HZ		1000000		///< timebase resolution, one count per micro-second
+#define TIMEBASE_ALARM_MAX_US	65000		///< furthest ahead an alarm can be set, inside one 16-bit counter wrap
+
+// Public Function Declarations
+void timebase_init(void);
+uint64_t timebase_us(void);
+uint64_t timebase_us_since(uint64_t start);
+void timebase_alarm_set(uint64_t at_us);
+void timebase_alarm_cancel(void);
+
+#endif /* TIMEBASE_H_ */
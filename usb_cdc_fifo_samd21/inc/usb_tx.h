@@ -0,0 +1,31 @@
+/** 
+ * @file usb_tx.h
+ * @date 16.Oct.2026
+ * @brief Provides the non-blocking USB CDC transmit queue public function declarations
+ */
+#ifndef USB_TX_H_
+#define USB_TX_H_
+
+// System Libraries
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Defines
+#define USB_TX_BUFFER_SIZE		512			///< Size of the transmit byte ring, must be a power of two
+#define USB_TX_PACKET_SIZE		64			///< Full speed bulk IN max packet size, responses are coalesced up to a multiple of this
+#define USB_TX_FLUSH_MS			2			///< Max time in milli-seconds a partial packet waits for more data before it is sent
+
+// Public Function Declarations
+bool usb_tx_write(const uint8_t* buf, size_t len);
+bool usb_tx_stream(const uint8_t* buf, size_t len);
+bool usb_tx_streaming_busy(void);
+size_t usb_tx_free(void);
+bool usb_tx_idle(void);
+uint32_t usb_tx_queued_total(void);
+uint32_t usb_tx_sent_total(void);
+void usb_tx_flush(void);
+void usb_tx_task(void);
+void usb_tx_complete(uint32_t count);
+
+#endif /* USB_TX_H_ */
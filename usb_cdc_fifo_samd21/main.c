@@ -10,26 +10,34 @@
 #include "atmel_start_pins.h"
 #include "cmd_fifo.h"
 #include "commands.h"
+#include "idle.h"
 #include "irq.h"
 #include "usb_start.h"
 #include "registers.h"
 #include "led.h"
+#include "usb_tx.h"
+#include "task_sched.h"
+#include "soft_timer.h"
+#include "timebase.h"
 
 // Global Variables
 /** @defgroup Global_Variables Global Variables
  *  @{
  */
-extern fifo_handle_t g_command_fifo;			///< global variable of type fifo_handle_t for the usb command buffer
+extern fifo_handle_t g_command_lanes[];		///< global array of type fifo_handle_t for the usb command priority lanes
 extern volatile uint32_t g_board_millis;		///< global variable of type uint32_t to track the board's on time in milli-seconds
-extern volatile registers_t system_registers;	///< global variable of type registers_t to hold the values in various registers
-extern bool g_tx_packet_complete;				///< global variable of type bool to hold the usb tx complete flag
+extern volatile registers_t* volatile system_registers;	///< global pointer to the live bank of type registers_t that holds the values in various registers
 /** @} */ // end of Global_Variables
 
 // Function Declarations
 void usb_cdc_fifo_init(void);
+static void command_task(void);
+
+sched_task_t g_command_task = SCHED_TASK_INIT(command_task, SCHED_PRIORITY_HIGH);	///< posted by the USB callbacks when there is received data or a transfer completes
 
 /// @brief  The main function initializes the board and peripheral drivers then in the while loop it
-/// checks for a usb command, runs the idle daemon, and runs the status blink function. 
+/// advances the soft timers and runs the highest priority task they or the USB callbacks have
+/// posted. When no task is queued idle_task sleeps until a USB interrupt or the next timer.
 /// @param  void
 /// @return n/a
 int main(void)
@@ -37,19 +45,39 @@ int main(void)
 	usb_cdc_fifo_init();
 	
 	while(1){
-		if (fifo_count(g_command_fifo)){
-			process_command(g_command_fifo);
+		soft_timer_task();
+		if(!sched_run()){
+			idle_task();
 		}
-		led_blink_status_led();
 	}
 }
 
 void usb_cdc_fifo_init(void){
 	atmel_start_init();
-	g_command_fifo = fifo_init();
-	g_tx_packet_complete = true;
 	g_board_millis = 0;
+	registers_init();
 	irq_systick_init();
+	timebase_init();
+	led_init();
+}
+
+/// @brief  frames received packets, runs a batch of commands and flushes their replies. Posts
+/// itself again while either step made progress, since running a command may have made room
+/// for a packet that is still waiting to be framed and framing may have queued more commands.
+/// Once neither can move it waits to be posted: by the read callback for new data, or by the
+/// write callback when a line held behind a stream can run.
+/// @param  void
+/// @return n/a
+static void command_task(void){
+	bool framed = usb_rx_task();
+	uint8_t processed = process_commands(g_command_lanes, CMD_BATCH_MAX);
+	
+	if(processed){
+		usb_tx_flush();
+	}
 	
+	if(framed || processed){
+		sched_post(&g_command_task);
+	}
 }
 
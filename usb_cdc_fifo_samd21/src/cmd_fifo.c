@@ -2,48 +2,58 @@
  * @file cmd_fifo.c
  * @brief First in first out (FIFO) buffer to store commands
           or items to be processed at a more convienent time
+ *
+ * The FIFO is a single-producer/single-consumer ring. The producer (USB read callback)
+ * only ever writes 'tail' and the consumer (main loop) only ever writes 'head', so
+ * neither side needs a critical section. Both indices are free running.
+ *
+ * Storage is allocated statically with FIFO_DECLARE so every FIFO can have its own
+ * geometry without using the heap.
+ *
+ * Commands are packed into a byte ring as length-prefixed records so short commands
+ * only use the bytes they need. A record is never split across the end of the ring;
+ * if it does not fit in the remaining bytes a FIFO_RECORD_PAD prefix marks them as
+ * unused and the record starts over at the beginning of the ring. Every record is
+ * null terminated inside the ring.
+ *
+ * Because records are contiguous the producer can build an item in place with
+ * fifo_reserve()/fifo_commit() and the consumer can parse it in place with
+ * fifo_peek()/fifo_release(). fifo_push()/fifo_pop() are copying wrappers around them.
 */
 #include "cmd_fifo.h"
 
 // System Libraries
 #include <stdint.h>
 #include <stddef.h>
-#include <stdlib.h>
-#include <assert.h>
 #include <string.h>
 #include <stdbool.h>
 
 // Defines
-struct fifo_buf_t{
-    uint8_t buffer[FIFO_MAX_NUM_CMDS][FIFO_MAX_CMD_SIZE];
-    size_t  head;
-    size_t  tail;
-    uint8_t count;
-};
+#define FIFO_INDEX_LOAD(idx)			__atomic_load_n(&(idx), __ATOMIC_ACQUIRE)			///< read the index owned by the other side
+#define FIFO_INDEX_STORE(idx, val)		__atomic_store_n(&(idx), (val), __ATOMIC_RELEASE)	///< publish an index to the other side
 
 // Private Function Declarations
-static bool fifo_assert_size(size_t size);
-static inline void fifo_clear_location(fifo_handle_t fifo, uint8_t location);
+static bool fifo_assert_size(fifo_handle_t fifo, size_t size);
+static inline uint32_t fifo_offset(fifo_handle_t fifo, uint32_t index);
 
 // Private Functions
-/// @brief  Resets the an item in the fifo and fill values with the RESET_CHAR
-/// @param  fifo_handle_t	- the pointer handle to reset
-/// @param  uint8_t			- location of the item to be cleared
-/// @return void
-static inline void fifo_clear_location(fifo_handle_t fifo, uint8_t location){
-	for (uint8_t i=0; i<FIFO_MAX_CMD_SIZE; i++){
-		fifo->buffer[location][i]= RESET_CHAR;
-	}
+/// @brief  converts a free running index into an offset in the byte ring
+/// @param  fifo_handle_t	- the FIFO handle pointer
+/// @param  uint32_t		- free running head or tail index
+/// @return uint32_t		- offset of the index in the buffer
+static inline uint32_t fifo_offset(fifo_handle_t fifo, uint32_t index){
+	return index & fifo->mask;
 }
 
 /// @brief  checks that the size of the array is less than or equal to the max size
 /// that the fifo buffer allows per command
-/// @param  size_t    - number of characters in the buffer
-/// @return bool      - returns true if size is ok & false is size is too large
-static bool fifo_assert_size(size_t size){
+/// @param  fifo_handle_t	- the FIFO handle pointer
+/// @param  size_t    		- number of characters in the buffer
+/// @return bool      		- returns true if size is ok & false is size is too large
+static bool fifo_assert_size(fifo_handle_t fifo, size_t size){
   bool ret = false;
 
-  if(size <= FIFO_MAX_CMD_SIZE){
+  if(size <= fifo->max_item){
     ret = true;
   }
   else{
@@ -54,41 +64,19 @@ static bool fifo_assert_size(size_t size){
 }
 
 // Public Functions
-/// @brief  Reserves a block of memory for the fifo and returns the pointer handle
-/// @param  void
-/// @return fifo_handle_t -	fifo pointer handle
-fifo_handle_t fifo_init(void)
-{
-	fifo_handle_t fifo = malloc(sizeof(fifo_buf_t));
-	assert(fifo);
-	
-	fifo_reset_all(fifo);  
-	  
-	return fifo;
-}
-
-/// @brief  Releases the memory block for the pointer handle
-/// @param  fifo_handle_t	- the pointer handle that should be deleted
-/// @return void
-void fifo_free(fifo_handle_t fifo){
-	assert(fifo);
-	
-	free(fifo);
-}
-
-/// @brief  Resets the entire fifo and fills all values with the RESET_CHAR
+/// @brief  Resets the entire fifo and fills all values with the RESET_CHAR. Must not be
+/// called while the producer or consumer could be accessing the fifo.
 /// @param  fifo_handle_t	- the pointer handle to reset
 /// @return void
 void fifo_reset_all(fifo_handle_t fifo){
 	fifo->head = 0;
 	fifo->tail = 0;
-	fifo->count = 0;
+	fifo->pushed = 0;
+	fifo->popped = 0;
+	fifo->reserved = 0;
+	fifo->reserved_size = 0;
 
-	for (uint8_t i=0; i<FIFO_MAX_NUM_CMDS; i++){
-		for (uint8_t j=0; j<FIFO_MAX_CMD_SIZE; j++){
-			fifo->buffer[i][j]= RESET_CHAR;
-		}
-	}
+	memset(fifo->buffer, RESET_CHAR, fifo->mask + 1);
 }
 
 /// @brief  Checks if the FIFO is empty and returns true if it is
@@ -97,7 +85,7 @@ void fifo_reset_all(fifo_handle_t fifo){
 bool fifo_empty(fifo_handle_t fifo){
   bool ret = false;
 
-  if(fifo->count == 0){
+  if(FIFO_INDEX_LOAD(fifo->tail) == FIFO_INDEX_LOAD(fifo->head)){
     ret = true;
   }
   else{
@@ -107,13 +95,15 @@ bool fifo_empty(fifo_handle_t fifo){
   return ret;  
 }
 
-/// @brief  Checks if the FIFO is full and returns true if it is
+/// @brief  Checks if the FIFO is full and returns true if it is. The FIFO is full
+/// when an item of the max item size is no longer guaranteed to fit.
 /// @param  fifo_handle_t	- the FIFO handle pointer
 /// @return bool - true if full false if not
 bool fifo_full(fifo_handle_t fifo){
   bool ret = false;
+  uint32_t used = FIFO_INDEX_LOAD(fifo->tail) - FIFO_INDEX_LOAD(fifo->head);
  
-  if(fifo->count >= FIFO_MAX_NUM_CMDS){
+  if((fifo->mask + 1 - used) < (fifo->max_item + FIFO_RECORD_OVERHEAD)){
     ret = true;
   }
   else{
@@ -123,7 +113,95 @@ bool fifo_full(fifo_handle_t fifo){
   return ret;  
 }
 
-/// @brief  Resets the entire fifo and fills all values with the RESET_CHAR
+/// @brief  Reserves contiguous space for the next item so the producer can write it in
+/// place. Nothing is visible to the consumer until fifo_commit is called, and a new
+/// reservation replaces an uncommitted one. Only the producer may call this.
+/// @param  fifo_handle_t	- the pointer handle of the fifo you want to access
+/// @param	size_t			- max number of bytes that will be written to the item
+/// @return uint8_t*		- pointer to write the item to, NULL if there is no room
+uint8_t* fifo_reserve(fifo_handle_t fifo, size_t size)
+{
+  uint8_t* ret = NULL;
+  uint32_t tail = fifo->tail;
+  uint32_t free_bytes = fifo->mask + 1 - (tail - FIFO_INDEX_LOAD(fifo->head));
+  uint32_t offset = fifo_offset(fifo, tail);
+  uint32_t pad = 0;
+  
+  if((fifo->mask + 1 - offset) < (size + FIFO_RECORD_OVERHEAD)){
+    pad = fifo->mask + 1 - offset;		//record would wrap, skip to the start of the ring
+  }
+
+  if(!fifo_assert_size(fifo, size)){
+    ret = NULL;
+  }
+  else if(free_bytes < (pad + size + FIFO_RECORD_OVERHEAD)){
+    ret = NULL;
+  }
+  else{
+    if(pad){
+      fifo->buffer[offset] = FIFO_RECORD_PAD;	//not visible until the tail moves past it
+      tail += pad;
+      offset = 0;
+    }
+    fifo->reserved = tail;
+    fifo->reserved_size = size;
+    ret = &fifo->buffer[offset + FIFO_RECORD_HDR_SIZE];
+  }
+
+  return ret;
+}
+
+/// @brief  Grows the uncommitted reservation to 'size' bytes and keeps what was written to it,
+/// so the producer only has to reserve the bytes it has received so far. If the bigger record
+/// no longer fits before the end of the ring it is moved to the start. Only the producer may
+/// call this.
+/// @param  fifo_handle_t	- the pointer handle of the fifo you want to access
+/// @param	size_t			- new max number of bytes that will be written to the item
+/// @return uint8_t*		- pointer to write the item to, which may have moved, NULL if there is
+/// no room yet, in which case the reservation is left as it was
+uint8_t* fifo_extend(fifo_handle_t fifo, size_t size)
+{
+  uint8_t* old = &fifo->buffer[fifo_offset(fifo, fifo->reserved) + FIFO_RECORD_HDR_SIZE];
+  size_t kept = fifo->reserved_size;
+  uint8_t* ret = old;
+
+  if(size > kept){
+    ret = fifo_reserve(fifo, size);				//same place unless the record now has to skip to the start
+    if((ret != NULL) && (ret != old)){
+      memmove(ret, old, kept);
+    }
+  }
+
+  return ret;
+}
+
+/// @brief  Publishes the item written to the space returned by fifo_reserve. Only the
+/// producer may call this.
+/// @param  fifo_handle_t	- the pointer handle of the fifo you want to access
+/// @param	size_t			- number of bytes that were written, up to the reserved size
+/// @return bool			- returns 0 for failure & 1 for success
+bool fifo_commit(fifo_handle_t fifo, size_t size)
+{
+  bool ret = false;
+  uint32_t offset = fifo_offset(fifo, fifo->reserved);
+
+  if(size > fifo->reserved_size){
+    ret = false;
+  }
+  else{
+    fifo->buffer[offset] = (uint8_t)size;
+    fifo->buffer[offset + FIFO_RECORD_HDR_SIZE + size] = '\0';
+    FIFO_INDEX_STORE(fifo->tail, fifo->reserved + size + FIFO_RECORD_OVERHEAD);	//record is written before it becomes visible
+    FIFO_INDEX_STORE(fifo->pushed, fifo->pushed + 1);
+    fifo->reserved_size = 0;
+    ret = true;
+  }
+
+  return ret;
+}
+
+/// @brief  Copies an item into the byte ring as a length-prefixed record and publishes
+/// it to the consumer. Only the producer may call this.
 /// @param  fifo_handle_t	- the pointer handle of the fifo you want to access
 /// @param  uint8_t*		- pointer to the buffer that should be added to the fifo
 /// @param	size_t			- size of the buffer that should be added to the fifo, in bytes
@@ -131,43 +209,87 @@ bool fifo_full(fifo_handle_t fifo){
 bool fifo_push(fifo_handle_t fifo, uint8_t* buf, size_t size)
 {
   bool ret = false;
+  uint8_t* item = fifo_reserve(fifo, size);
 
-  if(fifo_full(fifo)){
-    ret = false;
-  }
-  else if(!fifo_assert_size(size)){
+  if(item == NULL){
     ret = false;
   }
   else{  
-    fifo_clear_location(fifo, fifo->tail);
-    memcpy(fifo->buffer[fifo->tail], buf, size);
-    fifo->tail = (fifo->tail + 1) % FIFO_MAX_NUM_CMDS;
-    fifo->count++;
-    ret = true;
+    memcpy(item, buf, size);
+    ret = fifo_commit(fifo, size);
   }
 
     return ret;
 }
 
-/// @brief  Takes the tail item and puts it into the item pointer (buffer)
+/// @brief  Returns the head item without removing it so the consumer can parse it in
+/// place. The item is null terminated and stays valid until fifo_release is called.
+/// Only the consumer may call this.
+/// @param  fifo_handle_t	- the pointer handle of the fifo you want to access
+/// @param  size_t*			- returns the size of the item in bytes, may be NULL
+/// @return uint8_t*		- pointer to the item, NULL if the fifo is empty
+uint8_t* fifo_peek(fifo_handle_t fifo, size_t* size)
+{
+  uint8_t* ret = NULL;
+  uint32_t head = fifo->head;
+  uint32_t offset = fifo_offset(fifo, head);
+
+  if (fifo_empty(fifo)){
+    ret = NULL;
+  }
+  else{
+    if(fifo->buffer[offset] == FIFO_RECORD_PAD){
+      offset = 0;								//unused bytes at the end of the ring
+      FIFO_INDEX_STORE(fifo->head, head + fifo->mask + 1 - fifo_offset(fifo, head));
+    }
+    if(size != NULL){
+      *size = fifo->buffer[offset];
+    }
+    ret = &fifo->buffer[offset + FIFO_RECORD_HDR_SIZE];
+  }
+
+  return ret;
+}
+
+/// @brief  Removes the head item returned by fifo_peek and hands its space back to the
+/// producer. Only the consumer may call this.
+/// @param  fifo_handle_t	- the pointer handle of the fifo you want to access
+/// @return void
+void fifo_release(fifo_handle_t fifo)
+{
+  uint32_t head;
+
+  if(fifo_peek(fifo, NULL) != NULL){
+    head = fifo->head;						//peek skips any padding
+    FIFO_INDEX_STORE(fifo->head, head + fifo->buffer[fifo_offset(fifo, head)] + FIFO_RECORD_OVERHEAD);	//record is read before it is handed back
+    FIFO_INDEX_STORE(fifo->popped, fifo->popped + 1);
+  }
+}
+
+/// @brief  Takes the head item and puts it into the item pointer (buffer). The item is
+/// null terminated when it is shorter than the buffer. Only the consumer may call this.
 /// @param  fifo_handle_t	- the pointer handle of the fifo you want to access
 /// @param  uint8_t*		- pointer to the buffer that should be removed from the fifo
-/// @param	size_t			- size of the buffer that should be added to the fifo, in bytes
+/// @param	size_t			- size of the buffer that the item is copied into, in bytes
 /// @return uint8_t			- returns 0 for failure & 1 for success
 bool fifo_pop(fifo_handle_t fifo, uint8_t* item, size_t size)
 {
   bool ret = false;
+  size_t len = 0;
+  uint8_t* head_item = fifo_peek(fifo, &len);
 
-  if (fifo_empty(fifo)){
-    ret = false;
-  }
-  else if (!fifo_assert_size(size)){
+  if (head_item == NULL){
     ret = false;
   }
   else{
-    memcpy(item, fifo->buffer[fifo->head], size);
-    fifo->head = (fifo->head + 1) % FIFO_MAX_NUM_CMDS;
-    fifo->count--;
+    if(len > size){
+      len = size;								//truncate to the callers buffer
+    }
+    memcpy(item, head_item, len);
+    if(len < size){
+      item[len] = '\0';
+    }
+    fifo_release(fifo);
     ret = true;
   }
 
@@ -178,5 +300,20 @@ bool fifo_pop(fifo_handle_t fifo, uint8_t* item, size_t size)
 /// @param  fifo_handle_t	- the pointer handle of the fifo you want to access
 /// @return uint8_t			- number of items in the fifo
 uint8_t fifo_count(fifo_handle_t fifo){
-	return fifo->count;
-}
\ No newline at end of file
+	return (uint8_t)(FIFO_INDEX_LOAD(fifo->pushed) - FIFO_INDEX_LOAD(fifo->popped));
+}
+
+/// @brief  Returns the highest priority lane that has an item in it. Lanes are ordered
+/// highest priority first. Only the consumer may call this.
+/// @param  const fifo_handle_t*	- array of lanes, highest priority first
+/// @param  uint8_t					- number of lanes in the array
+/// @return fifo_handle_t			- the lane to take the next item from, NULL if all are empty
+fifo_handle_t fifo_lanes_next(const fifo_handle_t* lanes, uint8_t num_lanes){
+	for(uint8_t i=0; i<num_lanes; i++){
+		if(!fifo_empty(lanes[i])){
+			return lanes[i];
+		}
+	}
+	
+	return NULL;
+}
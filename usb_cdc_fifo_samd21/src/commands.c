@@ -18,196 +18,591 @@
 #include "cmd_fifo.h"
 #include "version.h"
 #include "registers.h"
+#include "usb_tx.h"
+#include "hex.h"
+#include "telemetry.h"
+#include "crc16.h"
+#include "latency.h"
 
 // Defines
-#define HEX_BASE			16				///< pre-processor directive to define the hex number base for strtol function
-#define DEC_BASE			10				///< pre-processor directive to define the decimal number base for strtol function
-#define CMD_NUM_BASE		HEX_BASE		///< pre-processor directive to define the number base which is communicated over usb cdc
-#define USB_TIMEOUT_MS		10				///< pre-processor directive to define the send/transmit timeout for a USB write
 #define TX_ITEM_MAX_SIZE	64				///< pre-processor directive to define the max number of char's on a usb transmit
+#define BURST_BUF_SIZE		(BURST_MAX_COUNT * HEX_LINE_MAX_SIZE)	///< size of the burst read reply, one line per register
+#define SNAPSHOT_HDR_SIZE	3										///< mark and uint16 payload length
+#define SNAPSHOT_PAYLOAD_SIZE	(4 + 4 + (REG_MAP_SIZE * 4))		///< sequence number, board millis, register file
+#define SNAPSHOT_FRAME_SIZE	(SNAPSHOT_HDR_SIZE + SNAPSHOT_PAYLOAD_SIZE + 2)	///< header, payload and CRC
+#define MAX_SIZE(a, b)		(((a) > (b)) ? (a) : (b))
+#define STREAM_BUF_SIZE		MAX_SIZE(MAX_SIZE(BURST_BUF_SIZE, SNAPSHOT_FRAME_SIZE), LATENCY_DUMP_SIZE)	///< size of the buffer shared by the streamed replies
+
+_Static_assert(SNAPSHOT_PAYLOAD_SIZE <= UINT16_MAX, "snapshot payload length must fit its uint16 field");
 
 // Global Variables
-bool g_tx_packet_complete;
 volatile uint32_t g_board_millis;
-volatile registers_t system_registers;
+extern volatile registers_t* volatile system_registers;
+extern volatile uint32_t g_usb_rx_backpressure_count;
+extern volatile uint32_t g_usb_rx_byte_count;
+extern volatile uint32_t g_usb_rx_overflow_count;
+extern volatile uint32_t g_usb_rx_isr_max_ticks;
+extern volatile uint32_t g_usb_tx_drop_count;
+extern volatile uint32_t g_telemetry_skip_count;
 	
 // Private Function Declarations
-static void command_read_reg(const char* buf);
-static void command_write_reg(const char* buf);
-static void command_idn_request(void);
-static void command_status_request(void);
-static void usb_write(uint8_t* tx, uint8_t len);
-static bool command_timeout(uint32_t start_time);
+#define COMMAND_DECLARE(token, size, c0, c1, handler, min_args, max_args, flags) \
+	static void handler(const command_args_t* args);
+COMMAND_TABLE(COMMAND_DECLARE)
+static const command_t* command_lookup(const char* cmd, size_t size);
+static const char* command_execute(const char* cmd);
+static uint8_t* put_le16(uint8_t* buf, uint16_t value);
+static uint8_t* put_le32(uint8_t* buf, uint32_t value);
+static bool command_line_streams(const char* cmd);
+static bool command_parse_args(const command_t* entry, const char* buf, command_args_t* args);
+static void usb_write(const uint8_t* tx, size_t len);
 
-//Public Functions
-/// @brief  function is called when the fifo buffer is not empty. It pops the command
-///	off the fifo, determines if its a read, write, idn, or status command, then 
-/// sends the command arguments off to be processed further
-/// @param  fifo_handle_t - fifo buffer that holds the command to process
+// Private Variables
+#define COMMAND_ENTRY(token, size, c0, c1, handler, min_args, max_args, flags) \
+	[CMD_HASH(c0, c1)] = {token, size, min_args, max_args, flags, handler},
+static const char* command_resume;								///< rest of a line held behind an 'xcommit 1', NULL when the next line starts fresh
+static fifo_handle_t command_resume_fifo;						///< lane of the held line
+static uint8_t stream_buf[STREAM_BUF_SIZE] COMPILER_ALIGNED(4);	///< reply of a CMD_FLAG_STREAM command, streamed straight from here
+static const command_t command_table[CMD_HASH_SIZE] = {				///< commands indexed by the hash of their first two characters
+	COMMAND_TABLE(COMMAND_ENTRY)
+};
+
+#define COMMAND_CASE(token, size, c0, c1, handler, min_args, max_args, flags) \
+	case CMD_HASH(c0, c1): break;
+/// @brief  never called, a hash collision in COMMAND_TABLE is a duplicate case label error
+/// @param  int		- unused
 /// @return void
-void process_command(fifo_handle_t fifo){
-	static char command_buf[RX_BUFFER_SIZE];					//buffer to store command
-				
-	fifo_pop(fifo, (uint8_t*)command_buf, RX_BUFFER_SIZE);		//get the command from the fifo
+static inline void __attribute__((unused)) command_hash_check(int hash){
+	switch(hash){
+		COMMAND_TABLE(COMMAND_CASE)
+		default: break;
+	}
+}
+
+//Public Functions
+/// @brief  tells if process_command can run the next line right now. Nothing runs while an
+/// 'xcommit 1' waits for its tick, so writes queued behind it land after the swap instead of
+/// being refused. The wait is at most 1 ms and keeps the commands in order.
+/// @param  const fifo_handle_t* - command lanes, highest priority first
+/// @return bool - true if a lane holds a line and it is not waiting for the previous stream
+/// or a register commit
+bool command_ready(const fifo_handle_t* lanes){
+	fifo_handle_t fifo = fifo_lanes_next(lanes, FIFO_NUM_LANES);
 	
-	if(!strncmp((const char*)command_buf, (const char*)READ_REG_CMD, READ_REG_SIZE)){
-		command_read_reg(&command_buf[READ_REG_SIZE]);
+	if(registers_tick_pending()){
+		return false;													//SysTick posts the command task after the swap
 	}
-	else if(!strncmp((const char*)command_buf, (const char*)WRITE_REG_CMD, WRITE_REG_SIZE)){
-		command_write_reg(&command_buf[WRITE_REG_SIZE]);
+	if(command_resume != NULL){
+		return true;													//rest of a line that was already started
 	}
-	else if(!strncmp((const char*)command_buf, (const char*)IDN_CMD, IDN_SIZE)){
-		command_idn_request();
+	if(fifo == NULL){
+		return false;
 	}
-	else if(!strncmp((const char*)command_buf, (const char*)STATUS_CMD, STATUS_SIZE)){
-		command_status_request();
+	
+	return !(usb_tx_streaming_busy() && command_line_streams((const char*)fifo_peek(fifo, NULL)));
+}
+
+/// @brief  function is called when a command lane is not empty. It peeks the line in the
+/// highest priority lane and runs each command on it in order. A line can carry several
+/// commands separated by CMD_SEPARATOR [i.e. wr1 5;wr2 7;rr3]. Their responses are queued
+/// back to back on the transmit ring so they go out together when the batch is flushed.
+/// The line is parsed in place and released from the fifo once it has been handled. If a
+/// command on the line leaves a commit waiting for the tick the rest of the line is held and
+/// finished first on a later call.
+/// @param  const fifo_handle_t* - command lanes, highest priority first
+/// @return bool - true if a line or part of one was processed, false if every lane was empty
+/// or the line has to wait for the previous stream to be sent or a register commit
+bool process_command(const fifo_handle_t* lanes){
+	fifo_handle_t fifo = fifo_lanes_next(lanes, FIFO_NUM_LANES);
+	const char* command_buf;
+	fifo_lane_t lane = FIFO_LANE_HIGH;
+	
+	if(!command_ready(lanes)){
+		return false;													//empty, or left queued until the previous stream or commit
+	}
+	
+	if(command_resume != NULL){
+		fifo = command_resume_fifo;
+		command_buf = command_resume;
+		command_resume = NULL;
+	}
+	else{
+		command_buf = (const char*)fifo_peek(fifo, NULL);			//null terminated line in the fifo
+		while(lanes[lane] != fifo){
+			lane++;
+		}
+		latency_dequeue(lane, usb_tx_queued_total());
 	}
 	
+	while(command_buf != NULL){
+		command_buf = command_execute(command_buf);
+		if((command_buf != NULL) && registers_tick_pending()){
+			command_resume = command_buf;								//rest of the line runs after the swap
+			command_resume_fifo = fifo;
+			return true;
+		}
+	}
+	
+	latency_dispatched(usb_tx_queued_total());
+	fifo_release(fifo);
+	
+	return true;
+}
+
+/// @brief  drains up to 'max_cmds' commands from the lanes in one call so a burst of
+/// commands is handled without going back around the main loop for each one. The
+/// highest priority lane is checked again before every command.
+/// @param  const fifo_handle_t*	- command lanes, highest priority first
+/// @param  uint8_t					- max number of commands to process
+/// @return uint8_t					- number of commands that were processed
+uint8_t process_commands(const fifo_handle_t* lanes, uint8_t max_cmds){
+	uint8_t processed = 0;
+	
+	while((processed < max_cmds) && process_command(lanes)){
+		processed++;
+	}
+	
+	return processed;
+}
+
+/// @brief  classifies a received command by its table entry so the framer can queue it in
+/// the right priority lane. Commands flagged CMD_FLAG_PRIORITY bypass register traffic.
+/// @param  const uint8_t*	- the received command, not null terminated
+/// @param  size_t			- size of the command in bytes
+/// @return fifo_lane_t		- lane the command should be queued in
+fifo_lane_t command_lane(const uint8_t* cmd, size_t size){
+	const command_t* entry = command_lookup((const char*)cmd, size);
+	
+	if((entry != NULL) && (entry->flags & CMD_FLAG_PRIORITY)){
+		return FIFO_LANE_HIGH;
+	}
+	
+	return FIFO_LANE_NORMAL;
 }
 
 //Private Functions
+/// @brief  finds the table entry for a command in one hash and one compare
+/// @param  const char*		- the command, does not need to be null terminated
+/// @param  size_t			- size of the command in bytes
+/// @return const command_t*	- matching entry, NULL if the command is unknown
+static const command_t* command_lookup(const char* cmd, size_t size){
+	const command_t* entry;
+	
+	if(size == 0){
+		return NULL;
+	}
+	
+	entry = &command_table[CMD_HASH((uint8_t)cmd[0], (size > 1) ? (uint8_t)cmd[1] : 0)];
+	if((entry->handler == NULL) || (size < entry->size) || strncmp(cmd, entry->token, entry->size)){
+		return NULL;
+	}
+	
+	return entry;
+}
+
+/// @brief  looks up one command of a line, parses the arguments its entry asks for, then
+/// calls its handler. Unknown commands are skipped without a response.
+/// @param  const char*	- start of the command, ends at CMD_SEPARATOR or the null terminator
+/// @return const char*	- start of the next command on the line, NULL if this was the last
+static const char* command_execute(const char* cmd){
+	const char* next = strchr(cmd, CMD_SEPARATOR);
+	const command_t* entry;
+	command_args_t args;
+	
+	while(*cmd == ' '){
+		cmd++;															//allow "wr1 5; rr1"
+	}
+	
+	entry = command_lookup(cmd, (next != NULL) ? (size_t)(next - cmd) : strlen(cmd));
+	if(entry != NULL){
+		if(command_parse_args(entry, &cmd[entry->size], &args)){
+			entry->handler(&args);
+		}
+		else{
+			command_invalid(&args);
+		}
+	}
+	
+	return (next != NULL) ? (next + 1) : NULL;
+}
+
+/// @brief  checks if any command on a line streams its reply
+/// @param  const char*	- the line, null terminated
+/// @return bool		- true if a command on the line has CMD_FLAG_STREAM
+static bool command_line_streams(const char* cmd){
+	const command_t* entry;
+	const char* next;
+	
+	do{
+		next = strchr(cmd, CMD_SEPARATOR);
+		while(*cmd == ' '){
+			cmd++;
+		}
+		entry = command_lookup(cmd, (next != NULL) ? (size_t)(next - cmd) : strlen(cmd));
+		if((entry != NULL) && (entry->flags & CMD_FLAG_STREAM)){
+			return true;
+		}
+		if(next != NULL){
+			cmd = next + 1;												//next + 1 is not a valid pointer on the last command
+		}
+	}while(next != NULL);
+	
+	return false;
+}
+
+/// @brief  parses up to 'max_args' hex arguments following the command token
+/// @param  const command_t*	- table entry of the command
+/// @param  const char*			- text following the token, null terminated
+/// @param  command_args_t*		- filled with the parsed arguments
+/// @return bool				- true if at least 'min_args' arguments were found
+static bool command_parse_args(const command_t* entry, const char* buf, command_args_t* args){
+	args->text = buf;
+	args->end = buf;
+	args->count = 0;
+	while(args->count < entry->max_args){
+		buf = hex_parse(buf, &args->value[args->count]);
+		if(buf == NULL){
+			break;														//no more digits
+		}
+		args->count++;
+		args->end = buf;
+	}
+	
+	return (args->count >= entry->min_args);
+}
+
 /// @brief  read register command called by 'process_command'. Takes the argument from the 
-/// read register command [i.e. if cmd is rr1, the argument is 1], turns the arg into a integer,
-/// formats the response based on the read reg arg, then prints the response in hex over USB CDC
-/// @param  const char* - fifo buffer that holds the command argument to process
+/// read register command [i.e. if cmd is rr1, the argument is 1], looks the register up in
+/// the register map, then prints its value in hex over USB CDC. INVALID_RET is printed if the
+/// register does not exist or is not readable.
+/// @param  const command_args_t* - register number
 /// @return void 
-static void command_read_reg(const char* buf){
-	static char msg[TX_ITEM_MAX_SIZE];
+static void command_read_reg(const command_args_t* args){
+	static char msg[HEX_LINE_MAX_SIZE];
 	static uint8_t len;
-	static uint8_t reg_num;
+	uint32_t value;
 	
-	reg_num = strtol(buf, NULL, CMD_NUM_BASE);
-	
-	switch (reg_num){
-		case 0x1:
-			len = sprintf(msg, "0x%x\r\n", (unsigned int)system_registers.register_01);
-			break;
-		case 0x2:
-			len = sprintf(msg, "0x%x\r\n", (unsigned int)system_registers.register_02);
-			break;;
-		case 0x3:
-			len = sprintf(msg, "0x%x\r\n", (unsigned int)system_registers.register_03);
-			break;
-		default:
-			len = sprintf(msg, "0x%x\r\n", INVALID_RET);
-			break;
+	if(!register_read(args->value[0], &value)){
+		value = INVALID_RET;
 	}
+	len = hex_format_line(msg, value);
 
 	usb_write((uint8_t *)msg, len);
 }
 
 /// @brief  write register command called by 'process_command'. Takes the args from the
 /// write register command [i.e. if cmd is wr 3 50, the register arg is 3 and write/set arg is 0x50],
-/// Turns the args into a integers, them attempts to write the set value to the register granted
-/// its valid and in-bounds. It will print the set-value arg on success and INVALID_RET on failure
-/// @param  const char* - fifo buffer that holds the write reg arguments to process
-/// @return void
-static void command_write_reg(const char* buf){
-	static char ascii_reg[2];				//array to hold the register value
-	static char ascii_val[10];				//array to hold the set value
-	static char msg[TX_ITEM_MAX_SIZE];		//array to hold the return message
-	const char *p_arg = &buf[2];			//pointer to the passed arg
+/// then writes the set value through the register map. It will print the value stored in the
+/// register on success and INVALID_RET on failure
+/// @param  const command_args_t* - register number and set value
+/// @return void
+static void command_write_reg(const command_args_t* args){
+	static char msg[HEX_LINE_MAX_SIZE];		//array to hold the return message
 	static uint8_t len;
-	bool command_valid = false;				//bool for valid/invalid command
-	
-	memcpy((void*)ascii_reg, (void*)buf, 2);						//load ascii reg with reg value
-	uint8_t  reg = strtol((const char*)ascii_reg, NULL, CMD_NUM_BASE);	//convert ascii reg into integer
-	
-	memcpy((void*)ascii_val, (void*)p_arg, 10);						//load the ascii val with set value
-	unsigned int arg = strtol(ascii_val, NULL, CMD_NUM_BASE);			//convert ascii value into integer
-	
-	switch(reg){
-		case 0x1:
-			command_valid = true;
-			system_registers.register_01 = arg;
-			len = sprintf(msg, "0x%x\r\n", arg);		//return message is the set value
-			break;
-		case 0x2:
-			command_valid = true;						
-			system_registers.register_02 = arg;	
-			len = sprintf(msg, "0x%x\r\n", arg);		//return message is the set value
-			break;
-		case 0x3:
-			command_valid = true;						
-			system_registers.register_03 = arg;	
-			len = sprintf(msg, "0x%x\r\n", arg);		//return message is the set value
-			break;
-		default:
-			command_valid = false;
-			break;
-	}
-	
-	//create the return message
-	if(!command_valid){
-		len = sprintf(msg, "0x%x\r\n", INVALID_RET);	//invalid register write
+	uint32_t value = args->value[1];
+	
+	if(!register_write(args->value[0], &value)){					//return message is the stored value
+		value = INVALID_RET;
 	}
+	len = hex_format_line(msg, value);
 	
 	usb_write((uint8_t *)msg, len);						//write to usb cdc
 }
 
-static void command_idn_request(void){
-	static char	msg[TX_ITEM_MAX_SIZE];
+/// @brief  burst read command called by 'process_command' [i.e. br 10 20 reads 0x20 registers
+/// starting at 0x10]. The reply is one "0x%x\r\n" line per register, the same as rr, and is
+/// sent as a single multi-packet transfer. Registers that can't be read are printed as
+/// INVALID_RET. A count of zero or above BURST_MAX_COUNT, or a second streamed command on the
+/// same line, is answered with INVALID_RET.
+/// @param  const command_args_t* - first register number and number of registers
+/// @return void
+static void command_burst_read(const command_args_t* args){
+	uint32_t reg = args->value[0];
+	uint32_t count = args->value[1];
+	uint32_t value;
+	size_t len = 0;
+	
+	if((count == 0) || (count > BURST_MAX_COUNT) || usb_tx_streaming_busy()){
+		command_invalid(args);											//bad count or a second stream on the line
+		return;
+	}
+	
+	while(count--){
+		if(!register_read(reg++, &value)){
+			value = INVALID_RET;
+		}
+		len += hex_format_line((char*)&stream_buf[len], value);
+	}
+	
+	usb_tx_stream(stream_buf, len);
+}
+
+/// @brief  burst write command called by 'process_command' [i.e. bw 10 5 6 7 writes 5, 6 and 7
+/// to registers 0x10, 0x11 and 0x12]. Writes stop at the first register that can't be written.
+/// Prints the number of registers written, so the host can tell which writes took effect, and
+/// INVALID_RET only if nothing was written.
+/// @param  const command_args_t* - first register number and first value, the other values follow
+/// @return void
+static void command_burst_write(const command_args_t* args){
+	static char msg[HEX_LINE_MAX_SIZE];
+	static uint8_t len;
+	const char* buf = args->end;
+	uint32_t reg = args->value[0];
+	uint32_t value = args->value[1];
+	uint32_t count = 0;
+	
+	do{
+		if(!register_write(reg++, &value)){
+			break;														//the registers before it stay written
+		}
+		count++;
+		buf = hex_parse(buf, &value);
+	}while(buf != NULL);
+	
+	if(count == 0){
+		count = INVALID_RET;
+	}
+	
+	len = hex_format_line(msg, count);
+	usb_write((uint8_t *)msg, len);
+}
+
+/// @brief  binary snapshot command called by 'process_command'. Sends the whole register file
+/// in one packed little-endian frame for automated tools:
+/// '#', uint16 payload length, uint32 sequence number, uint32 board millis,
+/// uint32 register[REG_MAP_SIZE], uint16 CRC-16/CCITT-FALSE over everything before it.
+/// Register values are raw, post-read hooks are not run. Slots rr can't read, the unused
+/// register 0 and write only registers, are sent as INVALID_RET the same as rr answers them, so
+/// the frame never leaks a value the host could not read and each register keeps its offset.
+/// Answered with INVALID_RET if it is the second streamed command on the line.
+/// @param  const command_args_t* - unused
+/// @return void
+static void command_snapshot(const command_args_t* args){
+	static uint32_t sequence;
+	volatile registers_t* live = system_registers;					//one bank even if a commit lands meanwhile
+	const register_desc_t* desc;
+	uint8_t* buf = stream_buf;
+	
+	if(usb_tx_streaming_busy()){
+		command_invalid(args);
+		return;
+	}
+	
+	*buf++ = SNAPSHOT_MARK;
+	buf = put_le16(buf, SNAPSHOT_PAYLOAD_SIZE);
+	buf = put_le32(buf, sequence++);
+	buf = put_le32(buf, g_board_millis);
+	for(uint32_t reg = 0; reg < REG_MAP_SIZE; reg++){
+		desc = register_desc(reg);
+		buf = put_le32(buf, ((desc != NULL) && (desc->access & REG_ACCESS_RO)) ? live->value[reg] : INVALID_RET);
+	}
+	buf = put_le16(buf, crc16_update(CRC16_INIT, stream_buf, buf - stream_buf));
+	
+	usb_tx_stream(stream_buf, buf - stream_buf);
+}
+
+/// @brief  register transaction begin command called by 'process_command'. Writes after it
+/// land in the shadow registers until xcommit or xabort. Prints 0x0 on success and INVALID_RET
+/// if a transaction is already open.
+/// @param  const command_args_t* - unused
+/// @return void
+static void command_begin(const command_args_t* args){
+	static char msg[HEX_LINE_MAX_SIZE];
+	static uint8_t len;
 	
+	len = hex_format_line(msg, registers_begin() ? 0 : INVALID_RET);
+	usb_write((uint8_t *)msg, len);
+}
+
+/// @brief  register transaction commit command called by 'process_command' [i.e. xcommit
+/// swaps now, xcommit 1 swaps on the next ms tick and the commands after it wait for the
+/// swap]. Prints the number of writes committed and INVALID_RET if no transaction is open.
+/// @param  const command_args_t* - optional, non zero to commit on the next ms tick
+/// @return void
+static void command_commit(const command_args_t* args){
+	static char msg[HEX_LINE_MAX_SIZE];
+	static uint8_t len;
+	uint32_t writes;
+	
+	if(!registers_commit((args->count > 0) && (args->value[0] != 0), &writes)){
+		writes = INVALID_RET;
+	}
+	len = hex_format_line(msg, writes);
+	usb_write((uint8_t *)msg, len);
+}
+
+/// @brief  register transaction abort command called by 'process_command'. Throws away the
+/// shadow writes. Prints the number of writes discarded and INVALID_RET if no transaction
+/// is open.
+/// @param  const command_args_t* - unused
+/// @return void
+static void command_abort(const command_args_t* args){
+	static char msg[HEX_LINE_MAX_SIZE];
+	static uint8_t len;
+	uint32_t writes;
+	
+	if(!registers_abort(&writes)){
+		writes = INVALID_RET;
+	}
+	len = hex_format_line(msg, writes);
+	usb_write((uint8_t *)msg, len);
+}
+
+/// @brief  latency histogram dump command called by 'process_command'. Sends one line per
+/// stage (rx, que, dsp, tx, tot) with "<bucket>=<count>" for every bucket that is not empty.
+/// Bucket n counts latencies of 2^n to 2^(n+1)-1 cpu cycles. Answered with INVALID_RET if it
+/// is the second streamed command on the line.
+/// @param  const command_args_t* - unused
+/// @return void
+static void command_latency(const command_args_t* args){
+	if(usb_tx_streaming_busy()){
+		command_invalid(args);
+		return;
+	}
+	
+	usb_tx_stream(stream_buf, latency_format((char*)stream_buf));
+}
+
+/// @brief  latency histogram reset command called by 'process_command'. Prints 0x0.
+/// @param  const command_args_t* - unused
+/// @return void
+static void command_latency_clear(const command_args_t* args){
+	static char msg[HEX_LINE_MAX_SIZE];
+	static uint8_t len;
+	
+	latency_reset();
+	len = hex_format_line(msg, 0);
+	usb_write((uint8_t *)msg, len);
+}
+
+/// @brief  telemetry subscribe command called by 'process_command' [i.e. sub 64 1 3 pushes a
+/// sample of registers 1 and 3 every 0x64 = 100 ms]. Prints the number of registers subscribed
+/// on success and INVALID_RET if the period is zero or a register can't be read.
+/// @param  const command_args_t* - period in milli-seconds and first register, the others follow
+/// @return void
+static void command_subscribe(const command_args_t* args){
+	static char msg[HEX_LINE_MAX_SIZE];
+	static uint8_t len;
+	uint32_t regs[TELEMETRY_MAX_REGS];
+	const char* buf = args->end;
+	uint32_t value = INVALID_RET;
+	uint8_t count = 0;
+	
+	regs[count++] = args->value[1];
+	while((count < TELEMETRY_MAX_REGS) && ((buf = hex_parse(buf, &regs[count])) != NULL)){
+		count++;
+	}
+	
+	if(telemetry_subscribe(args->value[0], regs, count)){
+		value = count;
+	}
+	len = hex_format_line(msg, value);
+	usb_write((uint8_t *)msg, len);
+}
+
+/// @brief  telemetry unsubscribe command called by 'process_command'. Stops the samples and
+/// prints 0x0.
+/// @param  const command_args_t* - unused
+/// @return void
+static void command_unsubscribe(const command_args_t* args){
+	static char msg[HEX_LINE_MAX_SIZE];
+	static uint8_t len;
+	
+	telemetry_unsubscribe();
+	len = hex_format_line(msg, 0);
+	usb_write((uint8_t *)msg, len);
+}
+
+/// @brief  answers a command that could not be processed, such as a line that was too long
+/// for the receive framer, with the invalid response
+/// @param  const command_args_t* - unused
+/// @return void
+static void command_invalid(const command_args_t* args){
+	static char msg[TX_ITEM_MAX_SIZE];
+	static uint8_t len;
+	
+	len = hex_format_line(msg, INVALID_RET);
+	usb_write((uint8_t *)msg, len);
+}
+
+/// @brief  answers the identification request
+/// @param  const command_args_t* - unused
+/// @return void
+static void command_idn_request(const command_args_t* args){
 	//The identification string in format: <manufacturer>, <model>, <serial number>, <software version>/<hardware version>.	
-	sprintf(msg, "%s, %s, %s, %s/%s\r\n", MFG, MODEL, SERIAL_NUM, FW_VERSION, HW_VERSION);
+	static const char msg[] = MFG ", " MODEL ", " SERIAL_NUM ", " FW_VERSION "/" HW_VERSION "\r\n";
 
-	usb_write((uint8_t *)msg, sizeof(msg));
+	usb_write((const uint8_t *)msg, sizeof(msg) - 1);
 }
 
 /// @brief  prints out a verbose human readable multi-line status message that displays
-/// all states, registers, and values for debugging purposes.
-/// @param  void
+/// all states, registers, and values for debugging purposes. Registers are read through
+/// register_read like rr, so hooks run and write only registers show INVALID_RET.
+/// @param  const command_args_t* - unused
 /// @return void
-static void command_status_request(void){
+static void command_status_request(const command_args_t* args){
 	static uint8_t	tx[TX_ITEM_MAX_SIZE];
 	static uint8_t	len;
+	uint32_t value;
 	
 	//Registers
 	len = sprintf((char*)tx, "\r\n** Registers **\r\n");
 	usb_write((uint8_t*)tx, len);
-	len = sprintf((char*)tx, "Reg 0x01:\t0x%x\r\n", (unsigned int)system_registers.register_01);
+	for(uint32_t reg = 0; reg < REG_MAP_SIZE; reg++){
+		if(register_desc(reg) != NULL){
+			if(!register_read(reg, &value)){
+				value = INVALID_RET;										//write only, shown the same as rr shows it
+			}
+			len = sprintf((char*)tx, "Reg 0x%02x:\t0x%x\r\n", (unsigned int)reg, (unsigned int)value);
+			usb_write((uint8_t*)tx, len);
+		}
+	}
+	len = sprintf((char*)tx, "Board Millis:\t%lu\r\n", g_board_millis);
 	usb_write((uint8_t*)tx, len);
-	len = sprintf((char*)tx, "Reg 0x02:\t0x%x\r\n", (unsigned int)system_registers.register_02);
+	len = sprintf((char*)tx, "RX Stalls:\t%lu\r\n", g_usb_rx_backpressure_count);
 	usb_write((uint8_t*)tx, len);
-	len = sprintf((char*)tx, "Reg 0x03:\t0x%x\r\n", (unsigned int)system_registers.register_03);
+	len = sprintf((char*)tx, "RX Bytes:\t%lu\r\n", g_usb_rx_byte_count);
 	usb_write((uint8_t*)tx, len);
-	len = sprintf((char*)tx, "Board Millis:\t%lu\r\n", g_board_millis);
+	len = sprintf((char*)tx, "RX Overflows:\t%lu\r\n", g_usb_rx_overflow_count);
+	usb_write((uint8_t*)tx, len);
+	len = sprintf((char*)tx, "RX ISR Max:\t%lu\r\n", g_usb_rx_isr_max_ticks);
+	usb_write((uint8_t*)tx, len);
+	len = sprintf((char*)tx, "TX Drops:\t%lu\r\n", g_usb_tx_drop_count);
+	usb_write((uint8_t*)tx, len);
+	len = sprintf((char*)tx, "TLM Skips:\t%lu\r\n", g_telemetry_skip_count);
 	usb_write((uint8_t*)tx, len);
 }
 
-/// @brief  function prints out up to 64 bytes per transfer over USB CDC. Gives the cdc async
-/// write 10ms to transmit befor the function times out. Clears the tx_packet_complete flag
-/// before the write. The CDC write callback will set tx_packet_complete flag back to true. 
-/// The watchdog is reset after the USB write because it could be many 10's of milli-seconds
-/// before the stack pointer is back in the idle_daemon for a wdt reset for a sts command. 
-/// @param  uint8_t*	- Pointer to the message to print. Message is already const from the
-/// formatting from the command parsing functions. 'cdcdf_acm_write' discards the const qualifier. 
-/// @param uint8_t		- length of the message to print
-/// @return void
-static void usb_write(uint8_t* tx, uint8_t len){
-	static volatile uint32_t start_time;			//grab board-millis for start time of usb_write
+/// @brief  stores a uint16 little-endian
+/// @param  uint8_t*	- output
+/// @param  uint16_t	- value to store
+/// @return uint8_t*	- output advanced past the value
+static uint8_t* put_le16(uint8_t* buf, uint16_t value){
+	buf[0] = (uint8_t)value;
+	buf[1] = (uint8_t)(value >> 8);
 	
-	start_time = g_board_millis;
-	g_tx_packet_complete = false;
-	cdcdf_acm_write((uint8_t*)tx, len);
-	while(!g_tx_packet_complete && !command_timeout(start_time));
+	return buf + 2;
 }
 
-/// @brief  reads the current board_millis value and subtracts it from the start time. If this 
-/// value is greater than the timeout value, then the timeout is true. Otherwise timeout is false. 
-/// @param uint32_t	- board_millis value when the usb write function was called
-/// @return bool	- true if specified timeout is exceeded. False if the timeout is not exceeded.
-static bool command_timeout(uint32_t start_time){
-	static volatile bool ret = true;
+/// @brief  stores a uint32 little-endian
+/// @param  uint8_t*	- output
+/// @param  uint32_t	- value to store
+/// @return uint8_t*	- output advanced past the value
+static uint8_t* put_le32(uint8_t* buf, uint32_t value){
+	buf[0] = (uint8_t)value;
+	buf[1] = (uint8_t)(value >> 8);
+	buf[2] = (uint8_t)(value >> 16);
+	buf[3] = (uint8_t)(value >> 24);
 	
-	if((g_board_millis - start_time) > USB_TIMEOUT_MS){
-		ret = true;
-	}
-	else{
-		ret = false;
-	}
-	
-	return ret;
+	return buf + 4;
 }
 
-
+/// @brief  queues a response on the non-blocking USB transmit ring and returns straight
+/// away. The ring is sent in the background by the CDC write callback. If the ring is full
+/// the message is dropped and counted rather than waiting for the host.
+/// @param  const uint8_t*	- Pointer to the message to print
+/// @param  size_t			- length of the message to print, may span many packets
+/// @return void
+static void usb_write(const uint8_t* tx, size_t len){
+	usb_tx_write(tx, len);
+}
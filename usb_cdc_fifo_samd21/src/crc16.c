@@ -0,0 +1,34 @@
+/** 
+ * @file crc16.c
+ * @date 16.Oct.2026
+ * @brief CRC-16/CCITT-FALSE (polynomial 0x1021, init 0xFFFF, no reflection, no final xor).
+ * Uses a 16 entry table and processes a nibble at a time, a compromise between the 512 byte
+ * byte-wise table and the slow bit-wise loop on the Cortex-M0+.
+ */
+#include "crc16.h"
+
+// System Libraries
+#include <stddef.h>
+#include <stdint.h>
+
+// Private Variables
+static const uint16_t crc16_table[16] = {
+	0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+	0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
+};
+
+// Public Functions
+/// @brief  adds a buffer to a running CRC. Start with CRC16_INIT.
+/// @param  uint16_t		- CRC so far
+/// @param  const uint8_t*	- data to add
+/// @param  size_t			- length of the data in bytes
+/// @return uint16_t		- updated CRC
+uint16_t crc16_update(uint16_t crc, const uint8_t* buf, size_t len){
+	while(len--){
+		crc ^= (uint16_t)(*buf++) << 8;
+		crc = (crc << 4) ^ crc16_table[crc >> 12];
+		crc = (crc << 4) ^ crc16_table[crc >> 12];
+	}
+	
+	return crc;
+}
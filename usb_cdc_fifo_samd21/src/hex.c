@@ -0,0 +1,96 @@
+/** 
+ * @file hex.c
+ * @date 16.Oct.2026
+ * @brief Hex parse and format for the command path. The Cortex-M0+ has no hardware divider,
+ * so everything is done with shifts and masks instead of strtol and sprintf, which pull in
+ * newlib's generic formatted I/O and divide by the base for every digit.
+ */
+#include "hex.h"
+
+// System Libraries
+#include <stddef.h>
+#include <stdint.h>
+
+// Private Variables
+static const char hex_digits[16] = {'0','1','2','3','4','5','6','7','8','9','a','b','c','d','e','f'};
+
+// Public Functions
+/// @brief  parses a hex number, skipping leading spaces and an optional "0x". Like strtoul with
+/// an end pointer this stops at the first non hex char. A number with more than HEX_MAX_DIGITS
+/// digits does not fit in 32 bits and is rejected rather than truncated.
+/// @param  const char*	- text to parse, null terminated
+/// @param  uint32_t*	- returns the parsed value, unchanged if the number was rejected
+/// @return const char*	- pointer to the char after the last digit, NULL if there were no digits
+/// or too many
+const char* hex_parse(const char* buf, uint32_t* value){
+	uint32_t result = 0;
+	uint8_t digits = 0;
+	uint8_t c;
+	
+	while((*buf == ' ') || (*buf == '\t')){
+		buf++;
+	}
+	if((buf[0] == '0') && ((buf[1] | 0x20) == 'x')){
+		buf += 2;
+	}
+	
+	while(1){
+		c = (uint8_t)*buf;
+		if((uint8_t)(c - '0') <= 9){
+			c -= '0';
+		}
+		else if((uint8_t)((c | 0x20) - 'a') <= 5){					//0x20 folds upper case to lower case
+			c = (c | 0x20) - 'a' + 10;
+		}
+		else{
+			break;
+		}
+		if(++digits > HEX_MAX_DIGITS){
+			return NULL;												//does not fit in 32 bits
+		}
+		result = (result << 4) | c;
+		buf++;
+	}
+	
+	if(digits == 0){
+		return NULL;
+	}
+	
+	*value = result;
+	return buf;
+}
+
+/// @brief  formats a value as "0x" followed by lower case hex digits without leading zeros,
+/// the same as sprintf "0x%x". The output is not null terminated.
+/// @param  char*		- output, at least 2 + HEX_MAX_DIGITS bytes
+/// @param  uint32_t	- value to format
+/// @return uint8_t		- number of chars written
+uint8_t hex_format(char* buf, uint32_t value){
+	int8_t shift = 28;
+	uint8_t len = 2;
+	
+	buf[0] = '0';
+	buf[1] = 'x';
+	
+	while((shift > 0) && ((value >> shift) == 0)){
+		shift -= 4;														//skip leading zeros, keep the last digit
+	}
+	for(; shift >= 0; shift -= 4){
+		buf[len++] = hex_digits[(value >> shift) & 0xF];
+	}
+	
+	return len;
+}
+
+/// @brief  formats a value as a "0x%x\r\n" response line. The output is not null terminated.
+/// @param  char*		- output, at least HEX_LINE_MAX_SIZE bytes
+/// @param  uint32_t	- value to format
+/// @return uint8_t		- number of chars written
+uint8_t hex_format_line(char* buf, uint32_t value){
+	uint8_t len = hex_format(buf, value);
+	
+	buf[len++] = '\r';
+	buf[len++] = '\n';
+	
+	return len;
+}
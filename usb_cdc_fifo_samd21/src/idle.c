@@ -0,0 +1,66 @@
+/** 
+ * @file idle.c
+ * @date 16.Oct.2026
+ * @brief Puts the cpu to sleep whenever the scheduler has no task queued, until an interrupt or
+ * the next soft timer needs it. Every task is posted either by an interrupt (USB receive and
+ * transmit complete) or by a soft timer (transmit flush, telemetry, status LED), so the loop
+ * only runs when there is work.
+ *
+ * The check for work and the sleep run with interrupts disabled. An interrupt that arrives in
+ * between stays pending, and a pending interrupt wakes WFI even while it is masked, so no event
+ * can be missed. The interrupt is served as soon as interrupts are enabled again after waking.
+ *
+ * When the next deadline is more than one tick away the sleep is tickless: SysTick is stopped,
+ * a timebase alarm wakes the cpu at the deadline, and board millis catch up from the timebase.
+ */
+#include "idle.h"
+
+// System Libraries
+#include <stdbool.h>
+#include <stdint.h>
+
+// User Includes
+#include "atmel_start.h"
+#include "hal_sleep.h"
+#include "irq.h"
+#include "registers.h"
+#include "task_sched.h"
+#include "soft_timer.h"
+#include "timebase.h"
+
+#if IDLE_MAX_SLEEP_MS >= (TIMEBASE_ALARM_MAX_US / 1000) - 1
+#error "IDLE_MAX_SLEEP_MS plus the part ms since the last tick must fit in a timebase alarm"
+#endif
+
+// Global Variables
+extern volatile uint32_t g_board_millis;
+
+// Public Functions
+/// @brief  called by the main loop when the scheduler has nothing to run. Returns straight away
+/// if a task has been posted since, otherwise sleeps until an interrupt or the next timer.
+/// @param  void
+/// @return void
+void idle_task(void){
+	uint32_t wait = IDLE_MAX_SLEEP_MS;
+	uint32_t deadline;
+	uint32_t since_tick;
+	uint64_t start;
+	
+	CRITICAL_SECTION_ENTER()											//interrupts post tasks
+	if(soft_timer_next(&deadline) && ((int32_t)(deadline - g_board_millis) < (int32_t)wait)){
+		wait = deadline - g_board_millis;
+	}
+	if(!sched_pending() && ((int32_t)wait > 0)){
+		if((wait == 1) || registers_tick_pending() || !irq_systick_suspend(&since_tick)){
+			sleep(IDLE_SLEEP_MODE);										//the next tick wakes the loop
+		}
+		else{
+			start = timebase_us() - since_tick;							//time of the last tick
+			timebase_alarm_set(start + (wait * 1000));
+			sleep(IDLE_SLEEP_MODE);
+			timebase_alarm_cancel();
+			irq_systick_resume((uint32_t)timebase_us_since(start));
+		}
+	}
+	CRITICAL_SECTION_LEAVE()											//the interrupt that woke the cpu runs here
+}
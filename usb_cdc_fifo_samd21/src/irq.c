@@ -7,25 +7,137 @@
 #include "irq.h"
 
 // System Libraries
+#include <stdbool.h>
 #include <stdint.h>
 
 // User Includes
 #include "atmel_start.h"
+#include "peripheral_clk_config.h"
+#include "registers.h"
+#include "commands.h"
+#include "task_sched.h"
+
+// Defines
+#define IRQ_SYSTICK_PERIOD		(CONF_CPU_FREQUENCY / 1000)		///< cpu clocks per 1ms tick
+#define IRQ_CYCLES_PER_US		(CONF_CPU_FREQUENCY / 1000000)	///< cpu clocks per micro-second
+#define IRQ_US_PER_MS			1000
+#define IRQ_US_TO_MS_MAX		65536		///< irq_us_to_ms is exact below this
 
 // Global Variables
 volatile uint32_t g_board_millis;
 
+// Private Function Declarations
+static uint32_t irq_us_to_ms(uint32_t us);
+
 /// @brief  setups up the systick timer interrupt to fire every 1ms
 /// @param  n/a
 /// @return n/a
 void irq_systick_init(void){
-	SysTick_Config(SystemCoreClock/125);		//8MHz/1000 = 8000. There are 8000 clks every 1ms.
+	SysTick_Config(IRQ_SYSTICK_PERIOD);		//8MHz/1000 = 8000. There are 8000 clks every 1ms.
 	NVIC_EnableIRQ(SysTick_IRQn);				//enable systick
 }
 
-/// @brief	increment the board_millis variable once per milli-second of on time
+/// @brief  returns the current SysTick count, used to time short sections of code with
+/// irq_systick_ticks_since. The SysTick counts down once per cpu clock.
+/// @param  n/a
+/// @return uint32_t	- current SysTick count
+uint32_t irq_systick_now(void){
+	return SysTick->VAL;
+}
+
+/// @brief  returns the number of SysTick counts since 'start'. Only valid for sections shorter
+/// than one SysTick period (1ms).
+/// @param  uint32_t	- SysTick count returned by irq_systick_now at the start of the section
+/// @return uint32_t	- elapsed SysTick counts
+uint32_t irq_systick_ticks_since(uint32_t start){
+	uint32_t now = SysTick->VAL;
+	
+	if(now <= start){
+		return start - now;
+	}
+	return start + (SysTick->LOAD + 1) - now;		//counter reloaded during the section
+}
+
+/// @brief  returns a free running count of cpu cycles built from board millis and the SysTick
+/// count, used to time sections longer than one SysTick period. Wraps after 2^32 cycles.
+/// Safe to call from an interrupt that blocks the SysTick interrupt: a reload that is pending
+/// but not yet counted in board millis is added here.
+/// @param  n/a
+/// @return uint32_t	- cpu cycles since the board started
+uint32_t irq_cycles_now(void){
+	uint32_t millis;
+	uint32_t val;
+	bool pending;
+	
+	do{
+		millis = g_board_millis;
+		val = SysTick->VAL;
+		pending = (SCB->ICSR & SCB_ICSR_PENDSTSET_Msk) != 0;
+	}while(millis != g_board_millis);
+	
+	if(pending && (val > (SysTick->LOAD / 2))){
+		millis++;														//reloaded, SysTick_Handler has not run yet
+	}
+	
+	return (millis * (SysTick->LOAD + 1)) + (SysTick->LOAD - val);
+}
+
+/// @brief  stops SysTick for a tickless sleep. Must be called with interrupts disabled and
+/// followed by irq_systick_resume. Board millis do not advance while SysTick is stopped.
+/// @param  uint32_t*	- returns the micro-seconds since the last tick
+/// @return bool		- true if SysTick was stopped, false if a tick is due and it was left running
+bool irq_systick_suspend(uint32_t* since_tick_us){
+	if(SCB->ICSR & SCB_ICSR_PENDSTSET_Msk){
+		return false;
+	}
+	
+	SysTick->CTRL &= ~SysTick_CTRL_ENABLE_Msk;
+	if(SCB->ICSR & SCB_ICSR_PENDSTSET_Msk){
+		SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;						//reached zero as it stopped
+		return false;
+	}
+	
+	*since_tick_us = (SysTick->LOAD - SysTick->VAL) / IRQ_CYCLES_PER_US;
+	return true;
+}
+
+/// @brief  restarts SysTick after a tickless sleep. Board millis catch up by the whole ms that
+/// passed and the first period is cut short by the part ms, so the ticks stay in phase with the
+/// time actually slept. Must be called with interrupts still disabled.
+/// @param  uint32_t	- micro-seconds from the last tick before irq_systick_suspend to now
+/// @return n/a
+void irq_systick_resume(uint32_t elapsed_us){
+	uint32_t millis = irq_us_to_ms(elapsed_us);
+	uint32_t part = elapsed_us - (millis * IRQ_US_PER_MS);
+	
+	g_board_millis += millis;
+	
+	SysTick->LOAD = ((IRQ_US_PER_MS - part) * IRQ_CYCLES_PER_US) - 1;	//rest of the current ms
+	SysTick->VAL = 0;													//reload from LOAD on the next clock
+	SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+	SysTick->LOAD = IRQ_SYSTICK_PERIOD - 1;								//used from the following reload on
+}
+
+/// @brief	increment the board_millis variable once per milli-second of on time and apply
+/// a register commit that is waiting for the tick, waking the commands held behind it
 /// @param  n/a
 /// @return n/a
 void SysTick_Handler(void){
 	g_board_millis++;
-}
\ No newline at end of file
+	if(registers_tick()){
+		sched_post(&g_command_task);
+	}
+}
+// Private Functions
+/// @brief  divides micro-seconds by 1000 with a multiply and shifts, the M0+ has no divider and
+/// this runs on the wake up path before any interrupt is served. (us / 8) / 125 is exact for
+/// every us below IRQ_US_TO_MS_MAX, longer sleeps fall back to the library divide.
+/// @param  uint32_t	- micro-seconds
+/// @return uint32_t	- whole milli-seconds
+static uint32_t irq_us_to_ms(uint32_t us){
+	if(us >= IRQ_US_TO_MS_MAX){
+		return us / IRQ_US_PER_MS;
+	}
+	
+	return ((us >> 3) * 8389) >> 20;
+}
@@ -0,0 +1,183 @@
+/** 
+ * @file latency.c
+ * @date 16.Oct.2026
+ * @brief Measures where the time goes between a command arriving and its response leaving.
+ * Each command is timestamped when its packet is received, when it is queued in its lane,
+ * when process_command takes it out, when its handlers return, and when the USB transfer
+ * carrying the last byte of its response completes. The time spent in each stage goes into
+ * a log2 histogram in RAM, so percentiles can be read off under production load.
+ *
+ * Timestamps are cpu cycles from irq_cycles_now. A command's receive and queue timestamps
+ * wait in a small ring per lane until it is taken out, lanes keep their order so the rings
+ * stay in step with the lanes. Commands waiting for their response to be sent wait in a
+ * ring that the write callback drains.
+ */
+#include "latency.h"
+
+// System Libraries
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// User Includes
+#include "atmel_start.h"
+#include "hex.h"
+#include "irq.h"
+
+// Defines
+#define LAT_QUEUE_DEPTH			64			///< timestamps per lane, at least the max number of commands a lane holds
+#define LAT_TX_DEPTH			16			///< commands waiting for their response to be sent, must be a power of two
+#define LAT_MAX_LANE_SIZE		((FIFO_LANE_HIGH_SIZE > FIFO_LANE_NORMAL_SIZE) ? FIFO_LANE_HIGH_SIZE : FIFO_LANE_NORMAL_SIZE)
+
+_Static_assert(LAT_QUEUE_DEPTH >= (LAT_MAX_LANE_SIZE / (FIFO_RECORD_OVERHEAD + 1)), "a lane can hold more commands than LAT_QUEUE_DEPTH");
+_Static_assert((LAT_QUEUE_DEPTH & (LAT_QUEUE_DEPTH - 1)) == 0, "LAT_QUEUE_DEPTH must be a power of two");
+_Static_assert((LAT_TX_DEPTH & (LAT_TX_DEPTH - 1)) == 0, "LAT_TX_DEPTH must be a power of two");
+
+/// @brief timestamps of a command waiting in a lane
+struct _config_latency_queued{
+	uint32_t rx;			///< packet received
+	uint32_t enqueued;		///< queued in its lane
+};
+
+/// @brief a command waiting for its response to be sent
+struct _config_latency_tx{
+	uint32_t tx_end;		///< usb_tx byte count that includes the last byte of the response
+	uint32_t rx;			///< packet received
+	uint32_t done;			///< handlers returned
+};
+
+typedef struct _config_latency_queued latency_queued_t;	///< typedef struct for the lane timestamps
+typedef struct _config_latency_tx latency_tx_t;			///< typedef struct for the response timestamps
+
+// Private Variables
+static volatile uint32_t latency_hist[LAT_NUM_STAGES][LATENCY_NUM_BUCKETS];
+static latency_queued_t latency_queued[FIFO_NUM_LANES][LAT_QUEUE_DEPTH];
+static uint32_t latency_queued_head[FIFO_NUM_LANES];		///< next command to take out, per lane
+static uint32_t latency_queued_tail[FIFO_NUM_LANES];		///< next command to queue, per lane
+static latency_tx_t latency_tx[LAT_TX_DEPTH];
+static uint32_t latency_tx_head;							///< only written by the write callback
+static uint32_t latency_tx_tail;							///< only written by the main loop
+static latency_queued_t latency_current;					///< command being processed
+static uint32_t latency_current_tx;							///< usb_tx byte count when it was taken out
+static const char* const latency_names[LAT_NUM_STAGES] = {"rx", "que", "dsp", "tx", "tot"};
+
+// Private Function Declarations
+static void latency_record(latency_stage_t stage, uint32_t cycles);
+
+// Public Functions
+/// @brief  called by the framer when a command is queued in a lane
+/// @param  fifo_lane_t	- lane the command was queued in
+/// @param  uint32_t	- cycle count when the packet that ended the command was received
+/// @return void
+void latency_enqueue(fifo_lane_t lane, uint32_t rx_stamp){
+	latency_queued_t* q = &latency_queued[lane][latency_queued_tail[lane]++ & (LAT_QUEUE_DEPTH - 1)];
+	
+	q->rx = rx_stamp;
+	q->enqueued = irq_cycles_now();
+	latency_record(LAT_STAGE_RX, q->enqueued - q->rx);
+}
+
+/// @brief  called by process_command when it takes a command out of a lane
+/// @param  fifo_lane_t	- lane the command was taken from
+/// @param  uint32_t	- usb_tx_queued_total before the command runs
+/// @return void
+void latency_dequeue(fifo_lane_t lane, uint32_t tx_queued){
+	latency_current = latency_queued[lane][latency_queued_head[lane]++ & (LAT_QUEUE_DEPTH - 1)];
+	latency_current_tx = tx_queued;
+	latency_record(LAT_STAGE_QUEUE, irq_cycles_now() - latency_current.enqueued);
+	latency_current.enqueued = irq_cycles_now();						//start of the dispatch stage
+}
+
+/// @brief  called by process_command when every handler on the line has returned. The
+/// command waits for its response to be sent unless it had no response or the ring of
+/// waiting commands is full.
+/// @param  uint32_t	- usb_tx_queued_total after the command ran
+/// @return void
+void latency_dispatched(uint32_t tx_queued){
+	uint32_t now = irq_cycles_now();
+	uint32_t tail = latency_tx_tail;
+	latency_tx_t* tx;
+	
+	latency_record(LAT_STAGE_DISPATCH, now - latency_current.enqueued);
+	
+	if((tx_queued == latency_current_tx) || ((tail - __atomic_load_n(&latency_tx_head, __ATOMIC_ACQUIRE)) >= LAT_TX_DEPTH)){
+		return;
+	}
+	
+	tx = &latency_tx[tail & (LAT_TX_DEPTH - 1)];
+	tx->tx_end = tx_queued;
+	tx->rx = latency_current.rx;
+	tx->done = now;
+	__atomic_store_n(&latency_tx_tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+/// @brief  called from the write callback after a transfer completes. Records every waiting
+/// command whose last response byte has now been sent.
+/// @param  uint32_t	- usb_tx_sent_total
+/// @return void
+void latency_tx_done(uint32_t tx_sent){
+	uint32_t now = irq_cycles_now();
+	uint32_t head = latency_tx_head;
+	latency_tx_t* tx;
+	
+	while(head != __atomic_load_n(&latency_tx_tail, __ATOMIC_ACQUIRE)){
+		tx = &latency_tx[head & (LAT_TX_DEPTH - 1)];
+		if((int32_t)(tx_sent - tx->tx_end) < 0){
+			break;
+		}
+		latency_record(LAT_STAGE_TX, now - tx->done);
+		latency_record(LAT_STAGE_TOTAL, now - tx->rx);
+		head++;
+	}
+	__atomic_store_n(&latency_tx_head, head, __ATOMIC_RELEASE);
+}
+
+/// @brief  clears every histogram
+/// @param  void
+/// @return void
+void latency_reset(void){
+	CRITICAL_SECTION_ENTER()											//the write callback records too
+	for(uint8_t stage = 0; stage < LAT_NUM_STAGES; stage++){
+		for(uint8_t bucket = 0; bucket < LATENCY_NUM_BUCKETS; bucket++){
+			latency_hist[stage][bucket] = 0;
+		}
+	}
+	CRITICAL_SECTION_LEAVE()
+}
+
+/// @brief  formats the histograms, one line per stage: the stage name followed by
+/// "<bucket>=<count>" for every bucket that is not empty, all in 0x hex.
+/// @param  char*	- output, at least LATENCY_DUMP_SIZE bytes
+/// @return size_t	- number of chars written, not null terminated
+size_t latency_format(char* buf){
+	size_t len = 0;
+	uint32_t count;
+	
+	for(uint8_t stage = 0; stage < LAT_NUM_STAGES; stage++){
+		for(const char* name = latency_names[stage]; *name; name++){
+			buf[len++] = *name;
+		}
+		for(uint8_t bucket = 0; bucket < LATENCY_NUM_BUCKETS; bucket++){
+			count = latency_hist[stage][bucket];
+			if(count != 0){
+				buf[len++] = ' ';
+				len += hex_format(&buf[len], bucket);
+				buf[len++] = '=';
+				len += hex_format(&buf[len], count);
+			}
+		}
+		buf[len++] = '\r';
+		buf[len++] = '\n';
+	}
+	
+	return len;
+}
+
+// Private Functions
+/// @brief  adds one latency to the histogram of a stage
+/// @param  latency_stage_t	- stage the latency belongs to
+/// @param  uint32_t		- latency in cpu cycles
+/// @return void
+static void latency_record(latency_stage_t stage, uint32_t cycles){
+	latency_hist[stage][31 - __builtin_clz(cycles | 1)]++;				//floor(log2), zero counts as bucket 0
+}
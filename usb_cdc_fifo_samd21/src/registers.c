@@ -0,0 +1,211 @@
+/** 
+ * @file registers.c
+ * @date 16.Oct.2026
+ * @brief Register map engine. Every register is described by one line of REGISTER_MAP in
+ * registers.h. Reads and writes index the descriptor table by register number and check the
+ * access rights, width and hooks, so adding a register needs no new code.
+ *
+ * There are two banks of register values. 'system_registers' points at the live bank. Between
+ * registers_begin and registers_commit writes land in the other, shadow, bank so related
+ * registers can be changed without the device seeing the intermediate states. Commit swaps
+ * the pointer, which is a single store, so every register changes at the same instant.
+ * While a commit waits for the ms tick both banks are spoken for, so writes and new
+ * transactions are refused until the tick has swapped them. The command dispatcher holds
+ * commands back for that time, so a host never sees the refusal.
+ */
+#include "registers.h"
+
+// System Libraries
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Global Variables
+volatile registers_t* volatile system_registers;		///< live register bank, swapped on commit
+
+// Private Variables
+static volatile registers_t register_bank[2];			///< live and shadow register banks
+static volatile registers_t* volatile register_shadow;	///< bank written during a transaction
+static bool register_txn_open;							///< true between registers_begin and commit or abort
+static uint32_t register_txn_writes;					///< number of writes in the open transaction
+static volatile bool register_swap_pending;				///< true while a commit waits for the next ms tick
+
+#define REGISTER_DESC(number, name, width, access, reset, pre_write, post_read) \
+	[number] = {width, access, reset, pre_write, post_read},
+static const register_desc_t register_map[REG_MAP_SIZE] = {			///< descriptors indexed by register number
+	REGISTER_MAP(REGISTER_DESC)
+};
+
+#define REGISTER_CHECK(number, name, width, access, reset, pre_write, post_read) \
+	_Static_assert(((width) > 0) && ((width) <= 32), #name " width must be 1 to 32 bits");
+REGISTER_MAP(REGISTER_CHECK)
+
+// Private Function Declarations
+static void registers_swap(void);
+
+// Public Functions
+/// @brief  loads every register with its reset value
+/// @param  void
+/// @return void
+void registers_init(void){
+	for(uint32_t reg = 0; reg < REG_MAP_SIZE; reg++){
+		register_bank[0].value[reg] = register_map[reg].reset;
+	}
+	system_registers = &register_bank[0];
+	register_shadow = &register_bank[1];
+	register_txn_open = false;
+	register_swap_pending = false;
+}
+
+/// @brief  returns the descriptor of a register
+/// @param  uint32_t				- register number
+/// @return const register_desc_t*	- descriptor, NULL if the register does not exist
+const register_desc_t* register_desc(uint32_t reg){
+	if((reg >= REG_MAP_SIZE) || (register_map[reg].access == REG_ACCESS_NONE)){
+		return NULL;
+	}
+	
+	return &register_map[reg];
+}
+
+/// @brief  reads a register and runs its post-read hook
+/// @param  uint32_t	- register number
+/// @param  uint32_t*	- returns the register value
+/// @return bool		- true on success, false if the register does not exist or is not readable
+bool register_read(uint32_t reg, uint32_t* value){
+	const register_desc_t* desc = register_desc(reg);
+	
+	if((desc == NULL) || !(desc->access & REG_ACCESS_RO)){
+		return false;
+	}
+	
+	*value = system_registers->value[reg];								//reads see the live bank, even in a transaction
+	if(desc->post_read != NULL){
+		desc->post_read(reg, value);
+	}
+	
+	return true;
+}
+
+/// @brief  runs the pre-write hook of a register, masks the value to the register width
+/// and stores it. Inside a transaction the value is stored in the shadow bank.
+/// @param  uint32_t	- register number
+/// @param  uint32_t*	- value to write, returns the value as stored
+/// @return bool		- true on success, false if the register does not exist, is not
+/// writable, the hook rejected the value, or a commit is waiting for the ms tick
+bool register_write(uint32_t reg, uint32_t* value){
+	const register_desc_t* desc = register_desc(reg);
+	uint32_t set = *value;
+	
+	if((desc == NULL) || !(desc->access & REG_ACCESS_WO) || register_swap_pending){
+		return false;													//a write now would land in the bank about to be retired
+	}
+	
+	if((desc->pre_write != NULL) && !desc->pre_write(reg, &set)){
+		return false;
+	}
+	
+	if(desc->width < 32){
+		set &= (1UL << desc->width) - 1;
+	}
+	
+	if(register_txn_open){
+		register_shadow->value[reg] = set;
+		register_txn_writes++;
+	}
+	else{
+		system_registers->value[reg] = set;
+	}
+	*value = set;
+	
+	return true;
+}
+
+/// @brief  opens a transaction. The shadow bank starts as a copy of the live bank, so only
+/// the registers written before commit change.
+/// @param  void
+/// @return bool	- true on success, false if a transaction is already open or a commit is
+/// waiting for the ms tick
+bool registers_begin(void){
+	if(register_txn_open || register_swap_pending){
+		return false;
+	}
+	
+	for(uint32_t reg = 0; reg < REG_MAP_SIZE; reg++){
+		register_shadow->value[reg] = system_registers->value[reg];
+	}
+	register_txn_writes = 0;
+	register_txn_open = true;
+	
+	return true;
+}
+
+/// @brief  closes a transaction and makes every write in it live at once, either now or on
+/// the next ms tick so the change lines up with the board millis timebase
+/// @param  bool		- true to swap on the next ms tick, false to swap now
+/// @param  uint32_t*	- returns the number of writes in the transaction
+/// @return bool		- true on success, false if no transaction is open
+bool registers_commit(bool on_tick, uint32_t* writes){
+	if(!register_txn_open){
+		return false;
+	}
+	
+	register_txn_open = false;
+	*writes = register_txn_writes;
+	if(on_tick){
+		register_swap_pending = true;									//registers_tick swaps
+	}
+	else{
+		registers_swap();
+	}
+	
+	return true;
+}
+
+/// @brief  closes a transaction and throws its writes away
+/// @param  uint32_t*	- returns the number of writes discarded
+/// @return bool		- true on success, false if no transaction is open
+bool registers_abort(uint32_t* writes){
+	if(!register_txn_open){
+		return false;
+	}
+	
+	register_txn_open = false;
+	*writes = register_txn_writes;
+	
+	return true;
+}
+
+/// @brief  called from the SysTick interrupt every ms. Swaps the banks if a commit is waiting
+/// for the tick.
+/// @param  void
+/// @return bool	- true if the banks were swapped
+bool registers_tick(void){
+	if(!register_swap_pending){
+		return false;
+	}
+	
+	register_swap_pending = false;
+	registers_swap();
+	
+	return true;
+}
+
+/// @brief  returns true while a commit waits for the next ms tick. The ticks must keep running
+/// until it has been applied.
+/// @param  void
+/// @return bool	- true if registers_tick still has a swap to do
+bool registers_tick_pending(void){
+	return register_swap_pending;
+}
+
+// Private Functions
+/// @brief  makes the shadow bank live and the live bank the next shadow
+/// @param  void
+/// @return void
+static void registers_swap(void){
+	volatile registers_t* live = register_shadow;
+	
+	register_shadow = system_registers;
+	system_registers = live;											//single store, every register changes at once
+}
@@ -0,0 +1,199 @@
+/** 
+ * @file soft_timer.c
+ * @date 16.Oct.2026
+ * @brief Hierarchical timer wheel driven by board millis. Level 0 has one slot per milli-second
+ * for the next SOFT_TIMER_SLOTS ms, each slot of level 1 spans one turn of level 0 and so on. A
+ * timer is linked into the slot its expiry falls in, and whenever level 0 turns over the next
+ * slot of the level above is emptied and its timers are re-linked one level down.
+ *
+ * Arming and cancelling a timer is an insert into or an unlink from a slot list, and advancing
+ * the wheel by one ms only touches the slots for that ms, so the cost of each does not depend
+ * on how many timers are armed. Timers further ahead than SOFT_TIMER_RANGE wait in the last
+ * slot of the top level and are re-placed each time they are cascaded.
+ *
+ * Timers are only armed, cancelled and advanced from the main loop, never from an interrupt.
+ */
+#include "soft_timer.h"
+
+// System Libraries
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// User Includes
+#include "task_sched.h"
+
+// Defines
+#define SOFT_TIMER_MASK			(SOFT_TIMER_SLOTS - 1)										///< mask to turn a tick into a slot index
+#define SOFT_TIMER_SLOT(t, l)	(((t) >> (SOFT_TIMER_SLOT_BITS * (l))) & SOFT_TIMER_MASK)	///< slot of tick 't' in level 'l'
+#define SOFT_TIMER_SPAN(l)		(1UL << (SOFT_TIMER_SLOT_BITS * ((l) + 1)))					///< ticks ahead covered by levels 0 to 'l'
+
+// Global Variables
+extern volatile uint32_t g_board_millis;
+
+// Private Variables
+static soft_timer_t* soft_timer_wheel[SOFT_TIMER_LEVELS][SOFT_TIMER_SLOTS];
+static uint16_t soft_timer_count[SOFT_TIMER_LEVELS];		//armed timers in each level
+static uint32_t soft_timer_now;							//last tick the wheel has been advanced to, board millis start at 0 too
+
+// Private Function Declarations
+static void soft_timer_link(soft_timer_t* timer);
+static void soft_timer_unlink(soft_timer_t* timer);
+static void soft_timer_cascade(uint8_t level);
+static void soft_timer_expire(uint32_t tick);
+
+// Public Functions
+/// @brief  arms a timer to post its task 'delay_ms' from now, and every 'period_ms' after that
+/// if 'period_ms' is not 0. Re-arming a timer that is already armed moves it.
+/// @param  soft_timer_t*	- timer to arm
+/// @param  uint32_t		- milli-seconds until the first expiry, 0 expires on the next tick
+/// @param  uint32_t		- milli-seconds between later expiries, 0 for a one-shot timer
+/// @return void
+void soft_timer_arm(soft_timer_t* timer, uint32_t delay_ms, uint32_t period_ms){
+	soft_timer_cancel(timer);
+	timer->expires = soft_timer_now + ((delay_ms != 0) ? delay_ms : 1);
+	timer->period = period_ms;
+	soft_timer_link(timer);
+}
+
+/// @brief  stops a timer. Harmless if it is not armed. A task the timer has already posted
+/// still runs.
+/// @param  soft_timer_t*	- timer to stop
+/// @return void
+void soft_timer_cancel(soft_timer_t* timer){
+	if(timer->link != NULL){
+		soft_timer_unlink(timer);
+	}
+}
+
+/// @brief  returns true while a timer is armed
+/// @param  const soft_timer_t*	- timer to check
+/// @return bool				- true if the timer will expire
+bool soft_timer_armed(const soft_timer_t* timer){
+	return timer->link != NULL;
+}
+
+/// @brief  called from the main loop. Advances the wheel to the current board millis one tick
+/// at a time, cascading the upper levels as level 0 turns over and posting the task of every
+/// timer that expires.
+/// @param  void
+/// @return void
+void soft_timer_task(void){
+	uint32_t now = g_board_millis;
+	uint32_t tick;
+	
+	while(soft_timer_now != now){
+		tick = ++soft_timer_now;
+		for(uint8_t level = 1; (level < SOFT_TIMER_LEVELS) && (SOFT_TIMER_SLOT(tick, level - 1) == 0); level++){
+			soft_timer_cascade(level);
+		}
+		soft_timer_expire(tick);
+	}
+}
+
+/// @brief  returns the next board millis the wheel has work to do, either a level 0 slot with
+/// timers in it or a turn of level 0 that cascades armed timers from above. Looks at most one
+/// turn of level 0 ahead.
+/// @param  uint32_t*	- returns the board millis soft_timer_task next has to run by
+/// @return bool		- true if a timer is armed, false if the wheel is empty
+bool soft_timer_next(uint32_t* millis){
+	bool upper = false;
+	uint32_t tick;
+	
+	for(uint8_t level = 1; level < SOFT_TIMER_LEVELS; level++){
+		upper = upper || (soft_timer_count[level] != 0);
+	}
+	if(!upper && (soft_timer_count[0] == 0)){
+		return false;
+	}
+	
+	for(uint32_t ahead = 1; ahead <= SOFT_TIMER_SLOTS; ahead++){
+		tick = soft_timer_now + ahead;
+		if((upper && (SOFT_TIMER_SLOT(tick, 0) == 0)) || (soft_timer_wheel[0][SOFT_TIMER_SLOT(tick, 0)] != NULL)){
+			*millis = tick;
+			return true;
+		}
+	}
+	
+	*millis = soft_timer_now + SOFT_TIMER_SLOTS;
+	return true;
+}
+
+// Private Functions
+/// @brief  links a timer into the slot its expiry falls in, in the lowest level that reaches it.
+/// A timer due on the tick being processed, cascaded down or re-armed late, goes in that tick's
+/// slot and is expired straight after.
+/// @param  soft_timer_t*	- timer with 'expires' set
+/// @return void
+static void soft_timer_link(soft_timer_t* timer){
+	uint32_t delta = timer->expires - soft_timer_now;
+	uint32_t place = timer->expires;
+	soft_timer_t** slot;
+	uint8_t level = 0;
+	
+	if((int32_t)delta < 0){
+		place = soft_timer_now + 1;										//overdue, expires on the next tick
+	}
+	else if(delta >= SOFT_TIMER_RANGE){
+		place = soft_timer_now + SOFT_TIMER_RANGE - 1;					//waits at the top and is re-placed on cascade
+	}
+	
+	while((level < (SOFT_TIMER_LEVELS - 1)) && ((place - soft_timer_now) >= SOFT_TIMER_SPAN(level))){
+		level++;
+	}
+	
+	slot = &soft_timer_wheel[level][SOFT_TIMER_SLOT(place, level)];
+	timer->level = level;
+	timer->next = *slot;
+	if(timer->next != NULL){
+		timer->next->link = &timer->next;
+	}
+	timer->link = slot;
+	*slot = timer;
+	soft_timer_count[level]++;
+}
+
+/// @brief  takes a timer out of its slot
+/// @param  soft_timer_t*	- armed timer
+/// @return void
+static void soft_timer_unlink(soft_timer_t* timer){
+	*timer->link = timer->next;
+	if(timer->next != NULL){
+		timer->next->link = timer->link;
+	}
+	timer->next = NULL;
+	timer->link = NULL;
+	soft_timer_count[timer->level]--;
+}
+
+/// @brief  empties the current slot of a level and re-links its timers, which now fall in a
+/// lower level
+/// @param  uint8_t	- level to cascade, 1 or above
+/// @return void
+static void soft_timer_cascade(uint8_t level){
+	soft_timer_t** slot = &soft_timer_wheel[level][SOFT_TIMER_SLOT(soft_timer_now, level)];
+	soft_timer_t* timer;
+	
+	while((timer = *slot) != NULL){
+		soft_timer_unlink(timer);
+		soft_timer_link(timer);
+	}
+}
+
+/// @brief  posts the task of every timer in the level 0 slot of 'tick' and re-arms the
+/// periodic ones
+/// @param  uint32_t	- tick being processed
+/// @return void
+static void soft_timer_expire(uint32_t tick){
+	soft_timer_t** slot = &soft_timer_wheel[0][SOFT_TIMER_SLOT(tick, 0)];
+	soft_timer_t* timer;
+	
+	while((timer = *slot) != NULL){
+		soft_timer_unlink(timer);
+		if(timer->period != 0){
+			timer->expires += timer->period;
+			soft_timer_link(timer);										//still overdue goes on the next tick, one period per tick
+		}
+		sched_post(timer->task);
+	}
+}
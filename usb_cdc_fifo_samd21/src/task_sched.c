@@ -0,0 +1,95 @@
+/** 
+ * @file task_sched.c
+ * @date 16.Oct.2026
+ * @brief Cooperative run queue scheduler for the main loop. Interrupts and timers post tasks,
+ * the main loop runs them one at a time, highest priority first and in posting order within a
+ * priority. Each priority has its own FIFO run queue linked through the tasks themselves, so
+ * posting and picking the next task never allocate and take the same time however many tasks
+ * there are. A task that is already queued is not queued twice.
+ */
+#include "task_sched.h"
+
+// System Libraries
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// User Includes
+#include "atmel_start.h"
+
+/// @brief struct holding one run queue
+struct _config_sched_queue {
+	sched_task_t* head;		///< next task to run
+	sched_task_t* tail;		///< last task posted
+};
+
+typedef struct _config_sched_queue sched_queue_t;		///< typedef struct for a run queue
+
+// Private Variables
+static sched_queue_t sched_queue[SCHED_NUM_PRIORITIES];
+
+// Public Functions
+/// @brief  queues a task to run from the main loop. Safe from interrupts. Does nothing if the
+/// task is already queued, so an event that fires many times before the task runs is handled
+/// by a single run.
+/// @param  sched_task_t*	- task to run
+/// @return void
+void sched_post(sched_task_t* task){
+	sched_queue_t* queue = &sched_queue[task->priority];
+	
+	CRITICAL_SECTION_ENTER()
+	if(!task->queued){
+		task->queued = true;
+		task->next = NULL;
+		if(queue->tail == NULL){
+			queue->head = task;
+		}
+		else{
+			queue->tail->next = task;
+		}
+		queue->tail = task;
+	}
+	CRITICAL_SECTION_LEAVE()
+}
+
+/// @brief  runs the highest priority queued task. Called from the main loop. The task is taken
+/// off its queue before its handler runs so the handler can post itself again.
+/// @param  void
+/// @return bool	- true if a task was run, false if every run queue was empty
+bool sched_run(void){
+	sched_task_t* task = NULL;
+	
+	CRITICAL_SECTION_ENTER()
+	for(uint8_t i = 0; i < SCHED_NUM_PRIORITIES; i++){
+		task = sched_queue[i].head;
+		if(task != NULL){
+			sched_queue[i].head = task->next;
+			if(task->next == NULL){
+				sched_queue[i].tail = NULL;
+			}
+			task->queued = false;
+			break;
+		}
+	}
+	CRITICAL_SECTION_LEAVE()
+	
+	if(task == NULL){
+		return false;
+	}
+	
+	task->handler();
+	return true;
+}
+
+/// @brief  returns true if any task is queued. Safe with interrupts disabled.
+/// @param  void
+/// @return bool	- true if sched_run has a task to run
+bool sched_pending(void){
+	for(uint8_t i = 0; i < SCHED_NUM_PRIORITIES; i++){
+		if(sched_queue[i].head != NULL){
+			return true;
+		}
+	}
+	
+	return false;
+}
@@ -0,0 +1,122 @@
+/** 
+ * @file telemetry.c
+ * @date 16.Oct.2026
+ * @brief Pushes a timestamped sample of a set of registers to the host at a fixed period, so
+ * the host does not have to poll them with rr. Samples are built in the main loop and queued on
+ * the transmit ring like any other response, where they are coalesced into full packets.
+ *
+ * A sample frame is one line: "@<millis> <value> <value> ...\r\n" with every number in the
+ * same 0x hex format as the command replies.
+ */
+#include "telemetry.h"
+
+// System Libraries
+#include <stdbool.h>
+#include <stdint.h>
+
+// User Includes
+#include "commands.h"
+#include "hex.h"
+#include "registers.h"
+#include "task_sched.h"
+#include "soft_timer.h"
+#include "usb_tx.h"
+
+// Defines
+#define TELEMETRY_FRAME_SIZE	(1 + (TELEMETRY_MAX_REGS + 1) * (HEX_MAX_DIGITS + 3) + 2)	///< "@" + one "0x" number and separator per field + "\r\n"
+
+#define TELEMETRY_TX_HEADROOM	CMD_REPLY_MAX_SIZE	///< bytes of the transmit ring a sample must leave free, room for the largest command reply
+
+_Static_assert((TELEMETRY_FRAME_SIZE + TELEMETRY_TX_HEADROOM) <= USB_TX_BUFFER_SIZE, "a telemetry sample and its headroom must fit in the transmit ring");
+
+/// @brief struct that holds the active subscription
+struct _config_telemetry{
+	uint32_t	regs[TELEMETRY_MAX_REGS];	///< registers sampled in each frame
+	uint8_t		count;						///< number of registers, 0 when unsubscribed
+	uint32_t	period;						///< sample period in milli-seconds
+};
+
+typedef struct _config_telemetry telemetry_t;		///< typedef struct for the telemetry subscription
+
+// Global Variables
+extern volatile uint32_t g_board_millis;
+volatile uint32_t g_telemetry_skip_count;		///< number of samples skipped to keep TELEMETRY_TX_HEADROOM free for command replies
+
+// Private Variables
+static telemetry_t telemetry;
+static sched_task_t telemetry_sched = SCHED_TASK_INIT(telemetry_task, SCHED_PRIORITY_NORMAL);
+static soft_timer_t telemetry_timer = SOFT_TIMER_INIT(&telemetry_sched);
+
+// Public Functions
+/// @brief  starts pushing samples of a set of registers every 'period_ms'. Replaces any
+/// subscription that is already running.
+/// @param  uint32_t		- sample period in milli-seconds, 1 ms (1 kHz) is the fastest
+/// @param  const uint32_t*	- register numbers to sample, in frame order
+/// @param  uint8_t			- number of registers, 1 to TELEMETRY_MAX_REGS
+/// @return bool			- true on success, false if the period or a register is invalid
+bool telemetry_subscribe(uint32_t period_ms, const uint32_t* regs, uint8_t count){
+	uint32_t value;
+	
+	if((period_ms == 0) || (count == 0) || (count > TELEMETRY_MAX_REGS)){
+		return false;
+	}
+	for(uint8_t i = 0; i < count; i++){
+		if(!register_read(regs[i], &value)){
+			return false;												//every register must be readable
+		}
+	}
+	
+	telemetry.count = 0;												//stop sampling while the set changes
+	for(uint8_t i = 0; i < count; i++){
+		telemetry.regs[i] = regs[i];
+	}
+	telemetry.period = period_ms;
+	telemetry.count = count;
+	soft_timer_arm(&telemetry_timer, 0, period_ms);						//first sample on the next tick
+	
+	return true;
+}
+
+/// @brief  stops pushing samples
+/// @param  void
+/// @return void
+void telemetry_unsubscribe(void){
+	telemetry.count = 0;
+	soft_timer_cancel(&telemetry_timer);
+}
+
+/// @brief  run by the scheduler each time the periodic telemetry timer expires. Queues one
+/// sample frame per run, so commands are never starved. If the loop fell behind by more than a
+/// period the timer expiries collapse into one run and the missed samples are skipped instead
+/// of sent in a burst. A sample that would eat into TELEMETRY_TX_HEADROOM is skipped too, so a
+/// host that reads slowly loses samples before it loses command replies.
+/// @param  void
+/// @return void
+void telemetry_task(void){
+	static char frame[TELEMETRY_FRAME_SIZE];
+	uint32_t now = g_board_millis;
+	uint32_t value;
+	uint8_t len;
+	
+	if(telemetry.count == 0){
+		return;
+	}
+	
+	frame[0] = TELEMETRY_FRAME_MARK;
+	len = 1 + hex_format(&frame[1], now);
+	for(uint8_t i = 0; i < telemetry.count; i++){
+		if(!register_read(telemetry.regs[i], &value)){
+			value = INVALID_RET;
+		}
+		frame[len++] = ' ';
+		len += hex_format(&frame[len], value);
+	}
+	frame[len++] = '\r';
+	frame[len++] = '\n';
+	
+	if(usb_tx_free() < ((size_t)len + TELEMETRY_TX_HEADROOM)){
+		g_telemetry_skip_count++;
+		return;
+	}
+	usb_tx_write((const uint8_t*)frame, len);							//coalesced, sent by the flush deadline at the latest
+}
@@ -0,0 +1,140 @@
+/** 
+ * @file timebase.c
+ * @date 16.Oct.2026
+ * @brief 64-bit micro-second timebase. TC3 runs as a free 16-bit counter clocked from GCLK
+ * generator 0 and prescaled down to 1MHz; its overflow interrupt counts the upper bits. The
+ * input frequency is worked out from the GCLK and OSC8M configuration at compile time so a
+ * change to the clock tree either keeps the timebase in micro-seconds or fails to build.
+ */
+#include "timebase.h"
+
+// System Libraries
+#include <stdbool.h>
+#include <stdint.h>
+
+// User Includes
+#include "atmel_start.h"
+#include "hpl_gclk_config.h"
+#include "hpl_sysctrl_config.h"
+#include "peripheral_clk_config.h"
+
+// Defines
+#define TIMEBASE_OSC8M_HZ		(8000000UL >> CONF_OSC8M_PRESC)		///< OSC8M output after its prescaler
+#if CONF_GCLK_GEN_0_DIVSEL
+#define TIMEBASE_GCLK_DIV		(2UL << CONF_GCLK_GEN_0_DIV)		///< DIVSEL: divide by 2^(DIV+1)
+#elif CONF_GCLK_GEN_0_DIV > 1
+#define TIMEBASE_GCLK_DIV		(CONF_GCLK_GEN_0_DIV)				///< divide by DIV, 0 and 1 both mean 1
+#else
+#define TIMEBASE_GCLK_DIV		1UL
+#endif
+#define TIMEBASE_GCLK_HZ		(TIMEBASE_OSC8M_HZ / TIMEBASE_GCLK_DIV)	///< GCLK generator 0 frequency
+#define TIMEBASE_TC_DIV			(TIMEBASE_GCLK_HZ / TIMEBASE_TICK_HZ)	///< TC prescaler division needed for 1MHz
+#define TIMEBASE_TC_PRESCALER	((TIMEBASE_TC_DIV == 1)    ? 0 :		\
+								 (TIMEBASE_TC_DIV == 2)    ? 1 :		\
+								 (TIMEBASE_TC_DIV == 4)    ? 2 :		\
+								 (TIMEBASE_TC_DIV == 8)    ? 3 :		\
+								 (TIMEBASE_TC_DIV == 16)   ? 4 :		\
+								 (TIMEBASE_TC_DIV == 64)   ? 5 :		\
+								 (TIMEBASE_TC_DIV == 256)  ? 6 :		\
+								 (TIMEBASE_TC_DIV == 1024) ? 7 : -1)	///< CTRLA.PRESCALER field for TIMEBASE_TC_DIV
+#define TIMEBASE_WRAP_HALF		0x8000		///< counts below this were taken after a wrap
+
+_Static_assert(CONF_GCLK_GEN_0_SRC == GCLK_GENCTRL_SRC_OSC8M, "timebase expects GCLK0 to run from OSC8M");
+_Static_assert(TIMEBASE_GCLK_HZ == CONF_CPU_FREQUENCY, "GCLK0 frequency does not match CONF_CPU_FREQUENCY");
+_Static_assert((TIMEBASE_GCLK_HZ % TIMEBASE_TICK_HZ) == 0, "GCLK0 is not a whole number of MHz");
+_Static_assert(TIMEBASE_TC_PRESCALER >= 0, "no TC prescaler turns GCLK0 into 1MHz");
+
+// Private Variables
+static volatile uint32_t timebase_overflows;		//number of 65.536ms TC3 wraps, 32 bits of these last 8.9 years
+
+// Public Functions
+/// @brief  starts TC3 counting micro-seconds and enables its overflow interrupt. The interrupt
+/// is given the highest priority so nothing can preempt it between clearing the flag and
+/// counting the wrap, which timebase_us relies on.
+/// @param  n/a
+/// @return n/a
+void timebase_init(void){
+	timebase_overflows = 0;
+	
+	hri_pm_set_APBCMASK_TC3_bit(PM);
+	hri_gclk_write_CLKCTRL_reg(GCLK, GCLK_CLKCTRL_ID_TCC2_TC3 | GCLK_CLKCTRL_GEN_GCLK0 | GCLK_CLKCTRL_CLKEN);
+	
+	hri_tc_set_CTRLA_SWRST_bit(TC3);
+	while(hri_tc_get_CTRLA_SWRST_bit(TC3));
+	
+	hri_tc_write_CTRLA_reg(TC3, TC_CTRLA_MODE_COUNT16 | TC_CTRLA_PRESCALER(TIMEBASE_TC_PRESCALER));
+	hri_tc_wait_for_sync(TC3);
+	hri_tc_write_READREQ_reg(TC3, TC_READREQ_RREQ | TC_READREQ_RCONT | TC_READREQ_ADDR(TC_COUNT16_COUNT_OFFSET));	//keep COUNT synchronised for reads
+	hri_tc_set_INTEN_OVF_bit(TC3);
+	
+	NVIC_SetPriority(TC3_IRQn, 0);
+	NVIC_ClearPendingIRQ(TC3_IRQn);
+	NVIC_EnableIRQ(TC3_IRQn);
+	
+	hri_tc_set_CTRLA_ENABLE_bit(TC3);
+	hri_tc_wait_for_sync(TC3);
+}
+
+/// @brief  returns micro-seconds since timebase_init. Safe from thread and interrupt context,
+/// including interrupts that block TC3_Handler: a wrap that is flagged but not yet counted is
+/// added here when the count was sampled after it.
+/// @param  n/a
+/// @return uint64_t	- micro-seconds since the timebase started
+uint64_t timebase_us(void){
+	uint32_t overflows;
+	uint16_t count;
+	bool pending;
+	
+	do{
+		overflows = timebase_overflows;
+		count = hri_tccount16_read_COUNT_reg(TC3);
+		pending = hri_tc_get_INTFLAG_OVF_bit(TC3);
+	}while(overflows != timebase_overflows);
+	
+	if(pending && (count < TIMEBASE_WRAP_HALF)){
+		overflows++;												//wrapped, TC3_Handler has not run yet
+	}
+	
+	return ((uint64_t)overflows << 16) | count;
+}
+
+/// @brief  returns the micro-seconds elapsed since 'start'
+/// @param  uint64_t	- time returned by timebase_us at the start
+/// @return uint64_t	- elapsed micro-seconds
+uint64_t timebase_us_since(uint64_t start){
+	return timebase_us() - start;
+}
+
+/// @brief  raises the TC3 interrupt when the timebase reaches 'at_us', used to wake the
+/// cpu from sleep. Only the low 16 bits are compared so 'at_us' must be less than
+/// TIMEBASE_ALARM_MAX_US ahead. Replaces an alarm that is already set.
+/// @param  uint64_t	- timebase_us value to wake at
+/// @return n/a
+void timebase_alarm_set(uint64_t at_us){
+	hri_tccount16_write_CC_reg(TC3, 0, (uint16_t)at_us);
+	hri_tc_wait_for_sync(TC3);
+	hri_tc_clear_INTFLAG_MC0_bit(TC3);									//drop a match on the old compare value
+	hri_tc_set_INTEN_MC0_bit(TC3);
+}
+
+/// @brief  stops an alarm from firing. Harmless if it has fired or was never set.
+/// @param  n/a
+/// @return n/a
+void timebase_alarm_cancel(void){
+	hri_tc_clear_INTEN_MC0_bit(TC3);
+	hri_tc_clear_INTFLAG_MC0_bit(TC3);
+}
+
+/// @brief  counts a TC3 wrap, extending the 16-bit counter to 64 bits, and disarms an alarm
+/// that has fired. The alarm only has to wake the cpu, the main loop does the work.
+/// @param  n/a
+/// @return n/a
+void TC3_Handler(void){
+	if(hri_tc_get_INTFLAG_OVF_bit(TC3)){
+		hri_tc_clear_INTFLAG_OVF_bit(TC3);
+		timebase_overflows++;
+	}
+	if(hri_tc_get_INTFLAG_MC0_bit(TC3)){
+		timebase_alarm_cancel();
+	}
+}
@@ -0,0 +1,322 @@
+/** 
+ * @file usb_tx.c
+ * @date 16.Oct.2026
+ * @brief Non-blocking transmit queue for USB CDC. Command handlers append their response
+ * to a byte ring and return straight away. The ring is sent in the background, the CDC
+ * write callback chains the next transfer from the ring on its own.
+ *
+ * Small responses are coalesced. A transfer is only started once a full packet is queued,
+ * when usb_tx_flush() is called, or when the oldest unsent byte has waited USB_TX_FLUSH_MS.
+ * Without a flush only whole packets are sent so a multi-line reply goes out in the fewest
+ * full size packets.
+ *
+ * A transfer that ends on a packet boundary is only followed by a zero length packet (ZLP)
+ * at the end of a response, so the host read completes without splitting a long reply.
+ * Large buffers that outlive the call, such as register dumps and captured data, can be
+ * sent with usb_tx_stream() as one multi-packet transfer without copying them into the ring.
+ *
+ * The main loop is the only producer and only writes 'tail'. The write callback is the only
+ * consumer and only writes 'head'. A transfer is only started from the main loop when none
+ * is in flight, so the callback can never run at the same time.
+ */
+#include "usb_tx.h"
+
+// System Libraries
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+// User Includes
+#include "atmel_start.h"
+#include "task_sched.h"
+#include "soft_timer.h"
+
+// Defines
+#define USB_TX_MASK				(USB_TX_BUFFER_SIZE - 1)			///< mask to turn a free running index into a ring offset
+
+#if (USB_TX_BUFFER_SIZE & USB_TX_MASK) != 0
+#error "USB_TX_BUFFER_SIZE must be a power of two"
+#endif
+#if (USB_TX_PACKET_SIZE & (USB_TX_PACKET_SIZE - 1)) != 0 || (USB_TX_BUFFER_SIZE % USB_TX_PACKET_SIZE) != 0
+#error "USB_TX_PACKET_SIZE must be a power of two that divides USB_TX_BUFFER_SIZE"
+#endif
+
+// Global Variables
+volatile uint32_t g_usb_tx_drop_count;		///< number of responses dropped because the transmit ring was full
+
+// Private Variables
+static uint8_t usb_tx_buf[USB_TX_BUFFER_SIZE] COMPILER_ALIGNED(4);
+static uint32_t usb_tx_head;				///< free running index of the next byte to send, only written by the consumer
+static uint32_t usb_tx_tail;				///< free running index of the next byte to fill, only written by the producer
+static uint32_t usb_tx_inflight;			///< number of bytes in the transfer that is in flight
+static volatile bool usb_tx_busy;			///< true while a transfer is in flight
+static volatile bool usb_tx_flushing;		///< true until every byte queued before the last flush has been handed to the USB
+static bool usb_tx_zlp_owed;				///< true when the last transfer filled its last packet and was sent without a ZLP
+static uint32_t usb_tx_stamp;				///< board millis when the oldest unsent byte was queued
+static bool usb_tx_streaming;				///< true from usb_tx_stream() until the stream transfer completes
+static bool usb_tx_inflight_stream;		///< true when the transfer in flight is the stream rather than the ring
+static const uint8_t* usb_tx_stream_buf;	///< caller's buffer being streamed
+static uint32_t usb_tx_stream_len;			///< length of the caller's buffer
+static uint32_t usb_tx_stream_mark;		///< ring index the stream is sent after, keeps replies in order
+static uint32_t usb_tx_queued;				///< free running count of bytes accepted, ring and streams
+static uint32_t usb_tx_sent;				///< free running count of bytes sent, ring and streams
+static sched_task_t usb_tx_sched = SCHED_TASK_INIT(usb_tx_task, SCHED_PRIORITY_HIGH);
+static soft_timer_t usb_tx_timer = SOFT_TIMER_INIT(&usb_tx_sched);	///< expires at the flush deadline
+extern volatile uint32_t g_board_millis;
+
+// Private Function Declarations
+static void usb_tx_start(void);
+static bool usb_tx_waiting(void);
+static void usb_tx_deadline_start(void);
+
+// Public Functions
+/// @brief  appends a response to the transmit ring and starts sending it if the endpoint is
+/// idle. Never waits for the USB. The response is either queued whole or dropped.
+/// @param  const uint8_t*	- response to send
+/// @param  size_t			- length of the response in bytes
+/// @return bool			- true if the response was queued, false if the ring was full
+bool usb_tx_write(const uint8_t* buf, size_t len){
+	uint32_t tail = usb_tx_tail;
+	uint32_t offset = tail & USB_TX_MASK;
+	uint32_t first = USB_TX_BUFFER_SIZE - offset;
+	
+	if(len > usb_tx_free()){
+		g_usb_tx_drop_count++;
+		return false;
+	}
+	
+	if(!usb_tx_waiting()){
+		usb_tx_deadline_start();										//nothing was waiting, start the flush deadline
+	}
+	
+	if(first > len){
+		first = len;
+	}
+	memcpy(&usb_tx_buf[offset], buf, first);
+	memcpy(usb_tx_buf, &buf[first], len - first);						//wrapped part, if any
+	__atomic_store_n(&usb_tx_tail, tail + len, __ATOMIC_RELEASE);		//data is written before it becomes visible
+	usb_tx_queued += len;
+	
+	if(!usb_tx_busy){
+		usb_tx_start();
+	}
+	
+	return true;
+}
+
+/// @brief  sends everything queued so far without waiting for a full packet. Called by the
+/// main loop after each batch of commands so a reply is not held back by the deadline.
+/// @param  void
+/// @return void
+void usb_tx_flush(void){
+	if(!usb_tx_waiting() && !usb_tx_zlp_owed){
+		return;															//nothing waiting behind the transfer in flight
+	}
+	
+	usb_tx_flushing = true;
+	if(!usb_tx_busy){
+		usb_tx_start();
+	}
+}
+
+/// @brief  run by the scheduler whenever the flush deadline may have moved and when the flush
+/// timer expires. Flushes a partial packet once it has waited USB_TX_FLUSH_MS for more data,
+/// otherwise arms the flush timer for the rest of the wait. A transfer in flight needs no timer,
+/// its completion posts this task again.
+/// @param  void
+/// @return void
+void usb_tx_task(void){
+	uint32_t waited;
+	
+	if(usb_tx_busy || !(usb_tx_waiting() || usb_tx_zlp_owed)){
+		soft_timer_cancel(&usb_tx_timer);
+		return;
+	}
+	
+	waited = g_board_millis - usb_tx_stamp;
+	if(waited >= USB_TX_FLUSH_MS){
+		usb_tx_flush();
+	}
+	else{
+		soft_timer_arm(&usb_tx_timer, USB_TX_FLUSH_MS - waited, 0);
+	}
+}
+
+/// @brief  sends a caller owned buffer as a single multi-packet transfer, after everything
+/// already queued on the ring and before anything queued later. The buffer is not copied and
+/// must stay unchanged until usb_tx_streaming() returns false. Word aligned RAM buffers are
+/// sent by the USB DMA directly, others are copied through the endpoint cache a packet at a time.
+/// @param  const uint8_t*	- buffer to send
+/// @param  size_t			- length of the buffer in bytes
+/// @return bool			- true if the stream was queued, false if one is already in progress
+bool usb_tx_stream(const uint8_t* buf, size_t len){
+	if(__atomic_load_n(&usb_tx_streaming, __ATOMIC_ACQUIRE)){
+		return false;
+	}
+	if(len == 0){
+		return true;
+	}
+	
+	if(!usb_tx_waiting()){
+		usb_tx_deadline_start();
+	}
+	usb_tx_stream_buf = buf;
+	usb_tx_stream_len = len;
+	usb_tx_stream_mark = usb_tx_tail;
+	usb_tx_queued += len;
+	__atomic_store_n(&usb_tx_streaming, true, __ATOMIC_RELEASE);		//stream is set up before the callback can see it
+	
+	if(!usb_tx_busy){
+		usb_tx_start();
+	}
+	
+	return true;
+}
+
+/// @brief  returns true while a buffer handed to usb_tx_stream() is still being sent
+/// @param  void
+/// @return bool	- true if the stream buffer is still in use
+bool usb_tx_streaming_busy(void){
+	return __atomic_load_n(&usb_tx_streaming, __ATOMIC_ACQUIRE);
+}
+
+/// @brief  returns the number of bytes accepted so far by usb_tx_write and usb_tx_stream. The
+/// last byte of a response is sent once usb_tx_sent_total reaches the value read after it.
+/// @param  void
+/// @return uint32_t	- free running count of bytes queued
+uint32_t usb_tx_queued_total(void){
+	return usb_tx_queued;
+}
+
+/// @brief  returns the number of bytes whose transfer has completed. Bytes complete in the
+/// order they were queued.
+/// @param  void
+/// @return uint32_t	- free running count of bytes sent
+uint32_t usb_tx_sent_total(void){
+	return __atomic_load_n(&usb_tx_sent, __ATOMIC_ACQUIRE);
+}
+
+/// @brief  returns the number of bytes that can be queued without dropping
+/// @param  void
+/// @return size_t	- free bytes in the transmit ring
+size_t usb_tx_free(void){
+	return USB_TX_BUFFER_SIZE - (usb_tx_tail - __atomic_load_n(&usb_tx_head, __ATOMIC_ACQUIRE));
+}
+
+/// @brief  returns true when everything queued has been sent
+/// @param  void
+/// @return bool	- true if no transfer is in flight
+bool usb_tx_idle(void){
+	return !usb_tx_busy;
+}
+
+/// @brief  called from the CDC write callback when a transfer completes. Hands the sent bytes
+/// back to the ring and chains the next transfer if more has been queued.
+/// @param  uint32_t	- number of bytes sent
+/// @return void
+void usb_tx_complete(uint32_t count){
+	__atomic_store_n(&usb_tx_sent, usb_tx_sent + usb_tx_inflight, __ATOMIC_RELEASE);
+	if(usb_tx_inflight_stream){
+		usb_tx_inflight_stream = false;
+		__atomic_store_n(&usb_tx_streaming, false, __ATOMIC_RELEASE);	//caller may reuse its buffer
+	}
+	else{
+		__atomic_store_n(&usb_tx_head, usb_tx_head + usb_tx_inflight, __ATOMIC_RELEASE);
+	}
+	usb_tx_inflight = 0;
+	usb_tx_start();
+	sched_post(&usb_tx_sched);											//a ZLP or leftover may now need the flush timer
+}
+
+// Private Functions
+/// @brief  starts the next transfer. Called from the main loop when no transfer is in flight,
+/// or from the write callback. Ring bytes queued ahead of a stream go first, then the stream
+/// as one transfer, then the rest of the ring. Unless a flush is pending only whole packets
+/// are sent from the ring, the partial packet left over waits for more data.
+/// @param  void
+/// @return void
+static void usb_tx_start(void){
+	uint32_t head = usb_tx_head;
+	uint32_t offset = head & USB_TX_MASK;
+	uint32_t tail = __atomic_load_n(&usb_tx_tail, __ATOMIC_ACQUIRE);
+	bool streaming = __atomic_load_n(&usb_tx_streaming, __ATOMIC_ACQUIRE);
+	bool zlp = false;
+	uint32_t pending;
+	uint32_t len;
+	
+	if(streaming && (head == usb_tx_stream_mark)){
+		usb_tx_inflight_stream = true;
+		usb_tx_inflight = usb_tx_stream_len;
+		usb_tx_zlp_owed = false;
+		usb_tx_busy = true;
+		if(cdcdf_acm_write_zlp((uint8_t*)usb_tx_stream_buf, usb_tx_stream_len, true) != ERR_NONE){
+			usb_tx_inflight_stream = false;
+			usb_tx_busy = false;										//not connected, retried on the next write
+			usb_tx_deadline_start();									//or by the flush deadline
+		}
+		return;
+	}
+	
+	if(streaming){
+		tail = usb_tx_stream_mark;										//only the bytes queued ahead of the stream
+	}
+	pending = tail - head;
+	len = pending;
+	if(len > (USB_TX_BUFFER_SIZE - offset)){
+		len = USB_TX_BUFFER_SIZE - offset;								//rest is sent by the next transfer
+	}
+	
+	if(streaming){
+		//the stream follows straight away, so no hold back and no ZLP
+	}
+	else if(usb_tx_flushing){
+		if(len == pending){
+			usb_tx_flushing = false;									//this transfer empties the ring
+			zlp = true;													//end of the response
+		}
+	}
+	else if(len == pending){
+		len &= ~(uint32_t)(USB_TX_PACKET_SIZE - 1);						//hold back the partial packet
+	}
+	
+	if(len < pending){
+		usb_tx_deadline_start();										//leftover starts a new deadline
+	}
+	
+	if((len == 0) && !(zlp && usb_tx_zlp_owed)){
+		usb_tx_busy = false;
+		return;
+	}
+	
+	usb_tx_zlp_owed = !zlp && ((len & (USB_TX_PACKET_SIZE - 1)) == 0);	//a full last packet leaves the host read open
+	usb_tx_inflight = len;
+	usb_tx_busy = true;
+	if(cdcdf_acm_write_zlp(&usb_tx_buf[offset], len, zlp) != ERR_NONE){
+		usb_tx_busy = false;											//not connected, retried on the next write
+		usb_tx_deadline_start();										//or by the flush deadline
+	}
+}
+
+/// @brief  returns true if bytes or a stream are queued behind the transfer in flight. Safe to
+/// call from the main loop while a transfer completes.
+/// @param  void
+/// @return bool	- true if there is something left to send
+static bool usb_tx_waiting(void){
+	bool waiting;
+	
+	CRITICAL_SECTION_ENTER()											//head, busy and inflight move together in the callback
+	waiting = usb_tx_tail != (usb_tx_head + ((usb_tx_busy && !usb_tx_inflight_stream) ? usb_tx_inflight : 0));
+	waiting = waiting || (usb_tx_streaming && !usb_tx_inflight_stream);
+	CRITICAL_SECTION_LEAVE()
+	
+	return waiting;
+}
+
+/// @brief  starts the flush deadline for the oldest unsent byte and has usb_tx_task time it.
+/// Safe from the write callback.
+/// @param  void
+/// @return void
+static void usb_tx_deadline_start(void){
+	usb_tx_stamp = g_board_millis;
+	sched_post(&usb_tx_sched);
+}
@@ -0,0 +1,36 @@
+/**
+ * @file size_hex.c
+ * @brief Code size comparison of the hex module against newlib. Built twice by 'make size' with
+ * the Cortex-M0+ cross compiler and the firmware's -Os and section garbage collection: once
+ * with hex_parse and hex_format_line, once with -DSIZE_LIBC and the strtoul and sprintf calls
+ * they replaced. Both images have the same startup code, so the difference in text size is
+ * the cost of each codec.
+ */
+#ifndef SIZE_LIBC
+#include "hex.h"
+#endif
+
+// System Libraries
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Private Variables
+static volatile uint32_t size_value;	///< keeps the calls from being optimized out
+static char size_line[16];				///< room for "0xffffffff\r\n"
+
+// Public Functions
+int main(void){
+	uint32_t value = 0;
+	
+#ifdef SIZE_LIBC
+	value = (uint32_t)strtoul(size_line, NULL, 16);
+	sprintf(size_line, "0x%lx\r\n", (unsigned long)(value + size_value));
+#else
+	hex_parse(size_line, &value);
+	hex_format_line(size_line, value + size_value);
+#endif
+	size_value = value;
+	
+	return 0;
+}
@@ -0,0 +1,296 @@
+/** 
+ * @file test_cmd_fifo.c
+ * @brief Host tests for the command FIFO. Built and run with 'make' in this directory, not part
+ * of the firmware. The lane tests check an empty lane always takes a full size line, that a
+ * growing reservation keeps its bytes and how many short lines a lane holds. The stress test
+ * runs the producer and the consumer on two threads the way the USB read callback and the main
+ * loop use a command lane, with lines of every length up to FIFO_MAX_CMD_SIZE, and fails if an
+ * item is lost, duplicated, corrupted or the ring stalls.
+ */
+#include "cmd_fifo.h"
+
+// System Libraries
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+// Defines
+#define TEST_STRESS_ITEMS		2000000		///< items passed from the producer to the consumer
+#define TEST_STALL_SPINS		100000		///< failed attempts in a row on an empty lane that count as a stall
+
+// Private Variables
+FIFO_DECLARE(stress_fifo, FIFO_LANE_NORMAL_SIZE, FIFO_MAX_CMD_SIZE);
+FIFO_DECLARE(lane_high, FIFO_LANE_HIGH_SIZE, FIFO_MAX_CMD_SIZE);
+FIFO_DECLARE(lane_normal, FIFO_LANE_NORMAL_SIZE, FIFO_MAX_CMD_SIZE);
+static volatile bool stress_failed;
+
+// Private Function Declarations
+static size_t stress_len(uint32_t i);
+static void* stress_producer(void* arg);
+static bool stress_consumer(void);
+static bool test_stress(void);
+static bool lane_cycle(fifo_handle_t fifo, const char* line, uint32_t cycles);
+static bool test_empty_lane_takes_full_line(void);
+static bool test_empty_lane_any_offset(void);
+static bool test_extend_keeps_line(void);
+static bool test_short_line_capacity(void);
+
+// Private Functions
+/// @brief  length of item 'i', cycles through every length from 1 to FIFO_MAX_CMD_SIZE in an
+/// order that does not repeat with the ring size
+/// @param  uint32_t	- item number
+/// @return size_t		- item length in bytes
+static size_t stress_len(uint32_t i){
+	return 1 + ((i * 37) % FIFO_MAX_CMD_SIZE);
+}
+
+/// @brief  pushes the items like the USB framer: most are built in place, either in a full size
+/// reservation or one grown with fifo_extend as the bytes arrive, and committed at their real
+/// length, the rest are copied in with fifo_push
+/// @param  void*	- unused
+/// @return void*	- unused
+static void* stress_producer(void* arg){
+	uint8_t line[FIFO_MAX_CMD_SIZE];
+	uint32_t spins = 0;
+	uint8_t* slot;
+	size_t len;
+	
+	for(uint32_t i = 0; (i < TEST_STRESS_ITEMS) && !stress_failed;){
+		len = stress_len(i);
+		memset(line, (uint8_t)('A' + (i % 26)), len);
+		line[0] = (uint8_t)i;
+		
+		if((i % 4) == 1){
+			slot = fifo_reserve(stress_fifo, FIFO_MAX_CMD_SIZE);
+			if(slot != NULL){
+				memcpy(slot, line, len);
+				fifo_commit(stress_fifo, len);
+			}
+		}
+		else if(i % 4){
+			slot = fifo_reserve(stress_fifo, (len + 1) / 2);
+			if(slot != NULL){
+				memcpy(slot, line, (len + 1) / 2);
+				slot = fifo_extend(stress_fifo, len);			//rest of the line, the reservation is kept on failure
+				while((slot == NULL) && !stress_failed){
+					sched_yield();
+					slot = fifo_extend(stress_fifo, len);
+				}
+			}
+			if(slot != NULL){
+				memcpy(&slot[(len + 1) / 2], &line[(len + 1) / 2], len - ((len + 1) / 2));
+				fifo_commit(stress_fifo, len);
+			}
+		}
+		else{
+			slot = fifo_push(stress_fifo, line, len) ? line : NULL;
+		}
+		
+		if(slot != NULL){
+			i++;
+			spins = 0;
+		}
+		else if(fifo_empty(stress_fifo) && (++spins > TEST_STALL_SPINS)){
+			printf("FAIL stress: lane is empty but refuses item %u of %u bytes\n", i, (unsigned)len);
+			stress_failed = true;
+		}
+		else{
+			sched_yield();												//let the consumer run on a single core host
+		}
+	}
+	
+	return arg;
+}
+
+/// @brief  takes the items in order with peek/release and pop and checks every byte
+/// @param  void
+/// @return bool	- true if every item arrived once, in order and intact
+static bool stress_consumer(void){
+	uint8_t line[FIFO_MAX_CMD_SIZE + 1];
+	uint8_t* item;
+	size_t len;
+	size_t expect;
+	
+	for(uint32_t i = 0; i < TEST_STRESS_ITEMS;){
+		if(stress_failed){
+			return false;
+		}
+		
+		expect = stress_len(i);
+		if(i % 3){
+			item = fifo_peek(stress_fifo, &len);
+		}
+		else{
+			item = fifo_pop(stress_fifo, line, sizeof(line)) ? line : NULL;
+			len = (item != NULL) ? expect : 0;
+		}
+		if(item == NULL){
+			sched_yield();
+			continue;
+		}
+		
+		if((len != expect) || (item[0] != (uint8_t)i) || (item[len - 1] != ((len > 1) ? (uint8_t)('A' + (i % 26)) : (uint8_t)i)) || (item[len] != '\0')){
+			printf("FAIL stress: item %u is corrupt or out of order\n", i);
+			stress_failed = true;
+			return false;
+		}
+		
+		if(i % 3){
+			fifo_release(stress_fifo);
+		}
+		i++;
+	}
+	
+	return true;
+}
+
+/// @brief  runs the producer on a second thread against the consumer on this one
+/// @param  void
+/// @return bool	- true on pass
+static bool test_stress(void){
+	pthread_t producer;
+	bool pass;
+	
+	fifo_reset_all(stress_fifo);
+	pthread_create(&producer, NULL, stress_producer, NULL);
+	pass = stress_consumer();
+	pthread_join(producer, NULL);
+	
+	return pass && !stress_failed && fifo_empty(stress_fifo);
+}
+
+/// @brief  pushes and pops 'line' through a lane 'cycles' times, leaving it empty with its
+/// tail moved on
+/// @param  fifo_handle_t	- lane to cycle
+/// @param  const char*		- line to push
+/// @param  uint32_t		- number of push/pop cycles
+/// @return bool			- true if every push and pop worked
+static bool lane_cycle(fifo_handle_t fifo, const char* line, uint32_t cycles){
+	uint8_t item[FIFO_MAX_CMD_SIZE + 1];
+	
+	for(uint32_t i = 0; i < cycles; i++){
+		if(!fifo_push(fifo, (uint8_t*)line, strlen(line)) || !fifo_pop(fifo, item, sizeof(item))){
+			return false;
+		}
+	}
+	
+	return fifo_empty(fifo);
+}
+
+/// @brief  regression for lanes that wedged empty: 9 x '*IDN?' through the high lane and
+/// 9 x 'wr1 5' through the normal lane left both tails in the middle of the ring, where the
+/// framer's full size reservation was refused for good
+/// @param  void
+/// @return bool	- true on pass
+static bool test_empty_lane_takes_full_line(void){
+	fifo_reset_all(lane_high);
+	fifo_reset_all(lane_normal);
+	
+	if(!lane_cycle(lane_high, "*IDN?", 9) || !lane_cycle(lane_normal, "wr1 5", 9)){
+		printf("FAIL empty lane: push/pop cycle failed\n");
+		return false;
+	}
+	if((fifo_reserve(lane_high, FIFO_MAX_CMD_SIZE) == NULL) || (fifo_reserve(lane_normal, FIFO_MAX_CMD_SIZE) == NULL)){
+		printf("FAIL empty lane: full size line refused by an empty lane\n");
+		return false;
+	}
+	
+	return true;
+}
+
+/// @brief  moves the tail of an empty lane to every offset with lines of every length and checks
+/// a full size line is always accepted
+/// @param  void
+/// @return bool	- true on pass
+static bool test_empty_lane_any_offset(void){
+	char line[FIFO_MAX_CMD_SIZE + 1];
+	
+	for(size_t len = 1; len <= FIFO_MAX_CMD_SIZE; len++){
+		memset(line, 'x', len);
+		line[len] = '\0';
+		fifo_reset_all(lane_normal);
+		for(uint32_t cycle = 0; cycle < FIFO_LANE_NORMAL_SIZE; cycle++){
+			if(!lane_cycle(lane_normal, line, 1) || (fifo_reserve(lane_normal, FIFO_MAX_CMD_SIZE) == NULL)){
+				printf("FAIL empty lane: full size line refused after %u lines of %u bytes\n", cycle + 1, (unsigned)len);
+				return false;
+			}
+		}
+	}
+	
+	return true;
+}
+
+/// @brief  grows a reservation that starts near the end of the ring until it has to skip to the
+/// start and checks the bytes already written move with it
+/// @param  void
+/// @return bool	- true on pass
+static bool test_extend_keeps_line(void){
+	uint8_t item[FIFO_MAX_CMD_SIZE + 1];
+	uint8_t* first;
+	uint8_t* slot;
+	size_t len = 0;
+	
+	fifo_reset_all(lane_normal);
+	if(!lane_cycle(lane_normal, "0123456789", 9)){						//tail 20 bytes before the end
+		printf("FAIL extend: push/pop cycle failed\n");
+		return false;
+	}
+	
+	slot = first = fifo_reserve(lane_normal, 4);
+	memcpy(slot, "wr1 ", 4);
+	for(len = 4; (slot != NULL) && (len < FIFO_MAX_CMD_SIZE); len++){
+		slot = fifo_extend(lane_normal, len + 1);
+		if(slot != NULL){
+			slot[len] = (uint8_t)('a' + (len % 26));
+		}
+	}
+	if((slot == NULL) || (slot == first) || !fifo_commit(lane_normal, len)){
+		printf("FAIL extend: reservation did not grow to a full size line at the start of the ring\n");
+		return false;
+	}
+	if(!fifo_pop(lane_normal, item, sizeof(item)) || (memcmp(item, "wr1 ", 4) != 0) || (item[FIFO_MAX_CMD_SIZE - 1] != (uint8_t)('a' + ((FIFO_MAX_CMD_SIZE - 1) % 26)))){
+		printf("FAIL extend: line was not kept when the reservation moved\n");
+		return false;
+	}
+	
+	return true;
+}
+
+/// @brief  fills an empty lane with 'wr1 5' reserving only the received bytes like the framer
+/// does, the lane must hold a line per 7 bytes and not a line per full size reservation
+/// @param  void
+/// @return bool	- true on pass
+static bool test_short_line_capacity(void){
+	uint32_t count = 0;
+	uint8_t* slot;
+	
+	fifo_reset_all(lane_normal);
+	while((slot = fifo_reserve(lane_normal, 5)) != NULL){
+		memcpy(slot, "wr1 5", 5);
+		fifo_commit(lane_normal, 5);
+		count++;
+	}
+	if(count != (FIFO_LANE_NORMAL_SIZE / (5 + FIFO_RECORD_OVERHEAD))){
+		printf("FAIL capacity: lane holds %u short lines\n", count);
+		return false;
+	}
+	
+	return true;
+}
+
+// Public Functions
+int main(void){
+	bool pass = true;
+	
+	pass = test_empty_lane_takes_full_line() && pass;
+	pass = test_empty_lane_any_offset() && pass;
+	pass = test_extend_keeps_line() && pass;
+	pass = test_short_line_capacity() && pass;
+	pass = test_stress() && pass;
+	
+	printf("%s\n", pass ? "PASS" : "FAIL");
+	return pass ? 0 : 1;
+}
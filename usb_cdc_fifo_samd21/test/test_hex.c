@@ -0,0 +1,150 @@
+/**
+ * @file test_hex.c
+ * @brief Host test and benchmark for the hex module. Built and run with 'make' in this
+ * directory, not part of the firmware. Checks hex_parse against strtoul and hex_format_line
+ * against sprintf "0x%x\r\n", checks numbers longer than HEX_MAX_DIGITS are rejected, then
+ * times both paths. The host has a divider, so the timings only show the shift and mask path is
+ * no slower, the gap on the Cortex-M0+ is wider. 'make size' compares the code size on the
+ * target, see size_hex.c.
+ */
+#include "hex.h"
+
+// System Libraries
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Defines
+#define TEST_VALUES			1000000		///< values checked against the C library
+#define BENCH_ROUNDS		5000000		///< parse and format round trips timed per path
+
+// Private Variables
+static volatile uint32_t bench_sink;	///< keeps the timed loops from being optimized out
+
+// Private Function Declarations
+static uint32_t test_value(uint32_t i);
+static double bench_seconds(void);
+static bool test_matches_libc(void);
+static bool test_rejects(void);
+static void bench(void);
+
+// Private Functions
+/// @brief  spreads the test values over every number of digits
+/// @param  uint32_t	- value number
+/// @return uint32_t	- value to test
+static uint32_t test_value(uint32_t i){
+	return (i * 2654435761u) >> (i % 32);
+}
+
+/// @brief  monotonic time for the benchmark
+/// @param  void
+/// @return double	- seconds
+static double bench_seconds(void){
+	struct timespec now;
+	
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + (now.tv_nsec * 1e-9);
+}
+
+/// @brief  formats and parses values with the hex module and the C library and compares them
+/// @param  void
+/// @return bool	- true on pass
+static bool test_matches_libc(void){
+	char ours[HEX_LINE_MAX_SIZE + 1];
+	char libc[HEX_LINE_MAX_SIZE + 1];
+	const char* end;
+	uint32_t value;
+	uint32_t parsed;
+	uint8_t len;
+	
+	for(uint32_t i = 0; i < TEST_VALUES; i++){
+		value = test_value(i);
+		len = hex_format_line(ours, value);
+		ours[len] = '\0';
+		sprintf(libc, "0x%x\r\n", value);
+		if(strcmp(ours, libc) != 0){
+			printf("FAIL format: 0x%x gave '%s'\n", value, ours);
+			return false;
+		}
+		
+		end = hex_parse(libc, &parsed);
+		if((end == NULL) || (parsed != (uint32_t)strtoul(libc, NULL, 16)) || (*end != '\r')){
+			printf("FAIL parse: '%s'\n", libc);
+			return false;
+		}
+	}
+	
+	return true;
+}
+
+/// @brief  checks the inputs hex_parse must refuse, a number longer than HEX_MAX_DIGITS used to
+/// be truncated to its first 8 digits
+/// @param  void
+/// @return bool	- true on pass
+static bool test_rejects(void){
+	static const char* const bad[] = {"123456789", "0x123456789", "000000000", "", " ", "0x", "g1"};
+	static const char* const good[] = {"12345678", "0xffffffff", " 0X0000000a;rr1", "7 8"};
+	uint32_t value = 0xA5A5A5A5;
+	
+	for(size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++){
+		if((hex_parse(bad[i], &value) != NULL) || (value != 0xA5A5A5A5)){
+			printf("FAIL reject: '%s' was accepted\n", bad[i]);
+			return false;
+		}
+	}
+	for(size_t i = 0; i < sizeof(good) / sizeof(good[0]); i++){
+		if(hex_parse(good[i], &value) == NULL){
+			printf("FAIL reject: '%s' was refused\n", good[i]);
+			return false;
+		}
+	}
+	
+	return true;
+}
+
+/// @brief  times a format and parse round trip with the hex module and with the C library
+/// @param  void
+/// @return void
+static void bench(void){
+	char line[HEX_LINE_MAX_SIZE + 1];
+	uint32_t value = 0;
+	uint32_t sum = 0;
+	double start;
+	double ours;
+	double libc;
+	
+	start = bench_seconds();
+	for(uint32_t i = 0; i < BENCH_ROUNDS; i++){
+		line[hex_format_line(line, test_value(i))] = '\0';
+		hex_parse(line, &value);
+		sum += value;
+	}
+	ours = bench_seconds() - start;
+	
+	start = bench_seconds();
+	for(uint32_t i = 0; i < BENCH_ROUNDS; i++){
+		sprintf(line, "0x%x\r\n", test_value(i));
+		sum += (uint32_t)strtoul(line, NULL, 16);
+	}
+	libc = bench_seconds() - start;
+	bench_sink = sum;
+	
+	printf("bench hex: %.1f ns per round trip, sprintf/strtoul %.1f ns\n", ours * 1e9 / BENCH_ROUNDS, libc * 1e9 / BENCH_ROUNDS);
+}
+
+// Public Functions
+int main(void){
+	bool pass = true;
+	
+	pass = test_matches_libc() && pass;
+	pass = test_rejects() && pass;
+	if(pass){
+		bench();
+	}
+	
+	printf("%s\n", pass ? "PASS" : "FAIL");
+	return pass ? 0 : 1;
+}
@@ -320,6 +320,17 @@ int32_t cdcdf_acm_write(uint8_t *buf, uint32_t size)
 	return usbdc_xfer(_cdcdf_acm_funcd.func_ep_in[CDCDF_ACM_DATA_EP_INDEX], buf, size, true);
 }
 
+/**
+ * \brief USB CDC ACM Function Write Data, with control of the trailing ZLP
+ */
+int32_t cdcdf_acm_write_zlp(uint8_t *buf, uint32_t size, bool zlp)
+{
+	if (!cdcdf_acm_is_enabled()) {
+		return ERR_DENIED;
+	}
+	return usbdc_xfer(_cdcdf_acm_funcd.func_ep_in[CDCDF_ACM_DATA_EP_INDEX], buf, size, zlp);
+}
+
 /**
  * \brief USB CDC ACM Stop the data transfer
  */
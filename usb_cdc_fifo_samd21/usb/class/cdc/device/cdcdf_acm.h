@@ -73,6 +73,16 @@ int32_t cdcdf_acm_read(uint8_t *buf, uint32_t size);
  */
 int32_t cdcdf_acm_write(uint8_t *buf, uint32_t size);
 
+/**
+ * \brief USB CDC ACM Function Write Data, with control of the trailing ZLP
+ * \param[in] buf Pointer to the buffer which stores data
+ * \param[in] size the size of data to be sent, may span many packets
+ * \param[in] zlp true to end a transfer that fills its last packet with a zero length packet.
+ *            Pass false when more data follows straight after this transfer.
+ * \return Operation status.
+ */
+int32_t cdcdf_acm_write_zlp(uint8_t *buf, uint32_t size, bool zlp);
+
 /**
  * \brief USB CDC ACM Stop the currnet data transfer
  */
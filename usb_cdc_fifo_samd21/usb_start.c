@@ -14,11 +14,29 @@
 #include "atmel_start.h"
 #include "cmd_fifo.h"
 #include "commands.h"
+#include "irq.h"
+#include "usb_tx.h"
+#include "latency.h"
+#include "task_sched.h"
 
 // Globals
-bool g_tx_packet_complete;
 static usb_buffer_t usb_buffer;
-fifo_handle_t g_command_fifo;
+static volatile bool usb_rx_armed;				///< true while the read endpoint is armed into a receive buffer
+static usb_rx_desc_t usb_rx_desc[USB_RX_NUM_BUFS];	///< received buffers waiting to be framed, one per receive buffer
+static uint32_t usb_rx_desc_head;				///< free running index of the next descriptor to frame, only written by the main loop
+static uint32_t usb_rx_desc_tail;				///< free running index of the next descriptor to fill, only written by the read callback
+static uint32_t usb_rx_head_idx;				///< index of the first byte of the oldest descriptor that has not been framed yet
+static uint32_t usb_rx_stamp;					///< receive timestamp of the descriptor being framed
+volatile uint32_t g_usb_rx_backpressure_count;	///< number of times the host was NAKed because every receive buffer was waiting
+volatile uint32_t g_usb_rx_isr_max_ticks;		///< longest time spent in the read callback, in SysTick counts
+volatile uint32_t g_usb_rx_byte_count;			///< number of bytes received on the read endpoint
+volatile uint32_t g_usb_rx_overflow_count;		///< number of lines discarded for being longer than RX_MAX_LINE_SIZE
+FIFO_DECLARE(g_command_fifo_high, FIFO_LANE_HIGH_SIZE, FIFO_MAX_CMD_SIZE);
+FIFO_DECLARE(g_command_fifo_normal, FIFO_LANE_NORMAL_SIZE, FIFO_MAX_CMD_SIZE);
+fifo_handle_t g_command_lanes[FIFO_NUM_LANES] = {
+	[FIFO_LANE_HIGH] = FIFO_HANDLE(g_command_fifo_high),
+	[FIFO_LANE_NORMAL] = FIFO_HANDLE(g_command_fifo_normal),
+};
 
 #if CONF_USBD_HS_SP
 static uint8_t single_desc_bytes[] = {
@@ -43,55 +61,285 @@ static struct usbd_descriptors single_desc[]
 #endif
 };
 
-/** Buffers to receive and echo the communication bytes. */
-static uint32_t usbd_cdc_buffer[CDCD_ECHO_BUF_SIZ / 4];
+/** Buffers to receive the communication bytes. One is armed while the other is framed. */
+static uint32_t usb_rx_buf[USB_RX_NUM_BUFS][CDCD_ECHO_BUF_SIZ / 4];
 
 /** Ctrl endpoint buffer */
 static uint8_t ctrl_buffer[64];
 
-/// @brief  callback when USB tx is complete. Sets the tx_packet_complete flag to true
+/// @brief  callback when USB tx is complete. Chains the next transfer from the transmit ring
 /// @param  n/a
 /// @return n/a
 static bool usb_device_cb_bulk_out(const uint8_t ep, const enum usb_xfer_code rc, const uint32_t count)
 {
-	g_tx_packet_complete = true;
+	usb_tx_complete(count);
+	latency_tx_done(usb_tx_sent_total());
+	sched_post(&g_command_task);										//a line may be waiting for a stream to finish
 
 	/* No error. */
 	return false;
 }
 
-/// @brief  callback on usb packet reception. Parses the characters and adds them to a buffer.
-/// Once the terminating character is identified it pushes the command the the FIFO
-/// @param  n/a
-/// @return n/a
-static bool usb_device_cb_bulk_in(const uint8_t ep, const enum usb_xfer_code rc, const uint32_t count)
+/// @brief  reserves a slot for the next command in the lowest priority lane that has room.
+/// The command is built there in place until its lane is known. Only the first run of
+/// characters is reserved, usb_rx_append grows the slot as more of the line arrives so short
+/// commands only use the bytes they need.
+/// @param  uint32_t - length of the first run of characters of the line
+/// @return bool - false if no lane has room and the packet should be held off
+static bool usb_rx_start_command(uint32_t len)
+{
+	usb_buffer.rx = NULL;
+	usb_buffer.rx_idx = 0;
+	if(len > RX_MAX_LINE_SIZE){
+		len = RX_MAX_LINE_SIZE;							//too long, usb_rx_append replaces it with an error
+	}
+	
+	for(int8_t lane = FIFO_NUM_LANES - 1; (lane >= 0) && (usb_buffer.rx == NULL); lane--){
+		usb_buffer.rx = fifo_reserve(g_command_lanes[lane], len);
+		usb_buffer.lane = (fifo_lane_t)lane;
+	}
+	
+	if(usb_buffer.rx != NULL){
+		usb_buffer.state = USB_RX_LINE;
+	}
+#if USB_RX_FLOW_CONTROL
+	return (usb_buffer.rx != NULL);
+#else
+	else{
+		usb_buffer.state = USB_RX_DROP;					//no room in any lane, drop this line
+	}
+	return true;
+#endif
+}
+
+/// @brief  classifies the completed command and commits it to its priority lane. Commands that
+/// belong in another lane than the one they were built in are copied there. If that lane is
+/// full a higher priority command stays where it is, a lower priority command has to wait
+/// (or is dropped without flow control).
+/// @param  void
+/// @return bool - false if the command has nowhere to go yet and the packet should be held off
+static bool usb_rx_end_command(void)
+{
+	fifo_lane_t lane = command_lane(usb_buffer.rx, usb_buffer.rx_idx);
+	uint8_t *slot = NULL;
+	
+	if(lane != usb_buffer.lane){
+		slot = fifo_reserve(g_command_lanes[lane], usb_buffer.rx_idx);
+	}
+	
+	if(slot != NULL){
+		memcpy(slot, usb_buffer.rx, usb_buffer.rx_idx);
+		fifo_commit(g_command_lanes[lane], usb_buffer.rx_idx);
+		latency_enqueue(lane, usb_rx_stamp);
+	}
+	else if(lane <= usb_buffer.lane){
+		fifo_commit(g_command_lanes[usb_buffer.lane], usb_buffer.rx_idx);
+		latency_enqueue(usb_buffer.lane, usb_rx_stamp);
+	}
+#if USB_RX_FLOW_CONTROL
+	else{
+		return false;									//keep the reservation and try again later
+	}
+#endif
+	usb_buffer.rx = NULL;
+	
+	return true;
+}
+
+/// @brief  finds the next line feed or carriage return in the received packet. Aligned words
+/// are tested 4 bytes at a time: a byte of the word equals c when the same byte of
+/// (word ^ c * 0x01010101) is zero, which the SWAR zero-byte test below picks out.
+/// @param  const uint8_t*	- received packet, word aligned
+/// @param  uint32_t		- index to start searching at
+/// @param  uint32_t		- number of characters in the packet
+/// @return uint32_t		- index of the first '\n' or '\r', equal to the packet size if there is none
+static uint32_t usb_rx_find_eol(const uint8_t *buf, uint32_t start, uint32_t count)
+{
+	uint32_t i = start;
+	uint32_t word;
+	
+	while((i < count) && (i & (sizeof(uint32_t) - 1))){			//single bytes up to the next word
+		if((buf[i] == '\n') || (buf[i] == '\r')){
+			return i;
+		}
+		i++;
+	}
+	while((i + sizeof(uint32_t)) <= count){
+		word = *(const uint32_t *)&buf[i];
+		if(SWAR_HAS_ZERO_BYTE(word ^ SWAR_REPEAT_BYTE('\n')) || SWAR_HAS_ZERO_BYTE(word ^ SWAR_REPEAT_BYTE('\r'))){
+			break;													//the loop below finds which byte it is
+		}
+		i += sizeof(uint32_t);
+	}
+	while(i < count){
+		if((buf[i] == '\n') || (buf[i] == '\r')){
+			return i;
+		}
+		i++;
+	}
+	
+	return count;
+}
+
+/// @brief  copies a run of command characters into the slot reserved for the command, growing
+/// the slot first if the line has outgrown it. If the line grows past RX_MAX_LINE_SIZE the slot
+/// is replaced with LINE_TOO_LONG_CMD so the command handler answers it with an error, and the
+/// rest of the line is discarded.
+/// @param  const uint8_t*	- first character to copy
+/// @param  uint32_t		- number of characters to copy
+/// @return bool			- false if the lane has no room to grow the slot yet and the packet
+/// should be held off
+static bool usb_rx_append(const uint8_t *buf, uint32_t len)
+{
+	uint8_t *slot;
+	
+	if((usb_buffer.rx_idx + len) > RX_MAX_LINE_SIZE){
+		memcpy(usb_buffer.rx, LINE_TOO_LONG_CMD, LINE_TOO_LONG_SIZE);	//fits, a slot holds at least the first byte
+		usb_buffer.rx_idx = LINE_TOO_LONG_SIZE;
+		usb_buffer.state = USB_RX_OVERFLOW;
+		g_usb_rx_overflow_count++;
+		return true;
+	}
+	
+	slot = fifo_extend(g_command_lanes[usb_buffer.lane], usb_buffer.rx_idx + len);
+	if(slot == NULL){
+#if USB_RX_FLOW_CONTROL
+		return false;									//keep what was received and try again later
+#else
+		usb_buffer.state = USB_RX_DROP;					//no room to grow, drop this line
+		return true;
+#endif
+	}
+	
+	usb_buffer.rx = slot;
+	memcpy(&usb_buffer.rx[usb_buffer.rx_idx], buf, len);
+	usb_buffer.rx_idx += len;
+	
+	return true;
+}
+
+/// @brief  frames the received characters into commands. Each run of characters up to the
+/// next line feed or carriage return is copied once, straight into a slot reserved in a
+/// command lane, and the command is committed to its lane at the line feed. The framer
+/// state is kept in usb_buffer so a line can span any number of packets.
+/// @param  const uint8_t*	- received packet, word aligned
+/// @param  uint32_t		- index of the first character to frame
+/// @param  uint32_t		- number of characters in the packet
+/// @return uint32_t		- index of the first character that was not framed, equal to the
+/// packet size unless the command lanes are full
+static uint32_t usb_rx_frame(const uint8_t *buf, uint32_t start, uint32_t count)
 {
-	uint8_t temp_buf[RX_BUFFER_SIZE];
-	
-	memcpy((void*)temp_buf, (void*)usbd_cdc_buffer, RX_BUFFER_SIZE);
-	
-	for(uint8_t i=0; i < count; i++){
-		if(usb_buffer.rx_idx >= RX_BUFFER_SIZE)
-		usb_buffer.rx_idx = 0;		//reset the buffer to prevent overflow
-		
-		usb_buffer.rx[usb_buffer.rx_idx] = (uint8_t)temp_buf[i];
-		if(usb_buffer.rx[usb_buffer.rx_idx] == '\r'){}				//do nothing if carriage return
-		else if(usb_buffer.rx[usb_buffer.rx_idx] == '\n'){			//line feed is terminating char
-			fifo_push(g_command_fifo, usb_buffer.rx, usb_buffer.rx_idx);	//send command to the buffer, not the newline char
-			usb_buffer.rx_idx = 0;		//reset the rx buffer
+	uint32_t i = start;
+	uint32_t eol;
+	
+	while(i < count){
+		eol = usb_rx_find_eol(buf, i, count);
+		if(eol > i){												//run of command characters
+			if((usb_buffer.state == USB_RX_IDLE) && !usb_rx_start_command(eol - i)){	//start the next command in place
+				break;
+			}
+			if((usb_buffer.state == USB_RX_LINE) && !usb_rx_append(&buf[i], eol - i)){
+				break;
+			}
+			i = eol;
+		}
+		else if(buf[i] == '\n'){									//line feed is terminating char
+			if(((usb_buffer.state == USB_RX_LINE) || (usb_buffer.state == USB_RX_OVERFLOW)) && !usb_rx_end_command()){
+				break;												//publish the command, not the newline char
+			}
+			usb_buffer.state = USB_RX_IDLE;
+			i++;
 		}
 		else{
-			usb_buffer.rx_idx++;		//increment the rx buffer index.
+			i++;													//do nothing if carriage return
 		}
 	}
-	/* Re-arm the cdc read callback */
-	cdcdf_acm_read((uint8_t *)usbd_cdc_buffer, sizeof(usbd_cdc_buffer));
+	
+	return i;
+}
+
+/// @brief  arms the read endpoint into the buffer of the next descriptor to fill. Must only be
+/// called when the endpoint is not armed and a descriptor is free.
+/// @param  void
+/// @return void
+static void usb_rx_arm(void)
+{
+	uint8_t idx = usb_rx_desc_tail % USB_RX_NUM_BUFS;
+	
+	usb_rx_armed = (cdcdf_acm_read((uint8_t *)usb_rx_buf[idx], sizeof(usb_rx_buf[idx])) == ERR_NONE);
+}
+
+/// @brief  callback on usb packet reception. Only records the filled buffer in the descriptor
+/// queue and re-arms the read endpoint into the next free buffer, framing is left to
+/// usb_rx_task in the main loop. Once every buffer is waiting the host is NAKed.
+/// @param  n/a
+/// @return n/a
+static bool usb_device_cb_bulk_in(const uint8_t ep, const enum usb_xfer_code rc, const uint32_t count)
+{
+	uint32_t start_ticks = irq_systick_now();
+	uint32_t tail = usb_rx_desc_tail;
+	uint32_t ticks;
+	
+	usb_rx_desc[tail % USB_RX_NUM_BUFS].buf = (const uint8_t *)usb_rx_buf[tail % USB_RX_NUM_BUFS];
+	usb_rx_desc[tail % USB_RX_NUM_BUFS].len = count;
+	usb_rx_desc[tail % USB_RX_NUM_BUFS].stamp = irq_cycles_now();
+	__atomic_store_n(&usb_rx_desc_tail, tail + 1, __ATOMIC_RELEASE);		//descriptor is written before it becomes visible
+	usb_rx_armed = false;
+	g_usb_rx_byte_count += count;
+	
+	if((tail + 1 - __atomic_load_n(&usb_rx_desc_head, __ATOMIC_ACQUIRE)) < USB_RX_NUM_BUFS){
+		usb_rx_arm();
+	}
+	else{
+		g_usb_rx_backpressure_count++;								//no free buffer, the main loop re-arms
+	}
+	sched_post(&g_command_task);
+	
+	ticks = irq_systick_ticks_since(start_ticks);
+	if(ticks > g_usb_rx_isr_max_ticks){
+		g_usb_rx_isr_max_ticks = ticks;
+	}
 
 
 	/* No error. */
 	return false;
 }
 
+/// @brief  called from the main loop. Frames the received buffers in the order they arrived,
+/// hands each buffer back once it is framed and re-arms the read endpoint if the read callback
+/// ran out of free buffers. If the command lanes fill up part way through a buffer it is
+/// finished on a later call, once commands have been processed.
+/// @param  void
+/// @return bool	- true if any received character was framed
+bool usb_rx_task(void)
+{
+	uint32_t head = usb_rx_desc_head;
+	uint32_t head_idx = usb_rx_head_idx;
+	usb_rx_desc_t *desc;
+	
+	while(head != __atomic_load_n(&usb_rx_desc_tail, __ATOMIC_ACQUIRE)){
+		desc = &usb_rx_desc[head % USB_RX_NUM_BUFS];
+		usb_rx_stamp = desc->stamp;
+		usb_rx_head_idx = usb_rx_frame(desc->buf, usb_rx_head_idx, desc->len);
+		if(usb_rx_head_idx < desc->len){
+			break;													//lanes are full
+		}
+		usb_rx_head_idx = 0;
+		head++;
+		__atomic_store_n(&usb_rx_desc_head, head, __ATOMIC_RELEASE);	//buffer is framed before it is handed back
+	}
+	
+	if(!usb_rx_armed){
+		CRITICAL_SECTION_ENTER()
+		if(!usb_rx_armed && ((usb_rx_desc_tail - usb_rx_desc_head) < USB_RX_NUM_BUFS)){
+			usb_rx_arm();
+		}
+		CRITICAL_SECTION_LEAVE()
+	}
+	
+	return (head != usb_rx_desc_head) || (head_idx != usb_rx_head_idx);
+}
+
 /**
  * \brief Callback invoked when Line State Change
  */
@@ -101,8 +349,10 @@ static bool usb_device_cb_state_c(usb_cdc_control_signal_t state)
 		/* Callbacks must be registered after endpoint allocation */
 		cdcdf_acm_register_callback(CDCDF_ACM_CB_READ, (FUNC_PTR)usb_device_cb_bulk_in);
 		cdcdf_acm_register_callback(CDCDF_ACM_CB_WRITE, (FUNC_PTR)usb_device_cb_bulk_out);
-		/* Start Rx */
-		cdcdf_acm_read((uint8_t *)usbd_cdc_buffer, sizeof(usbd_cdc_buffer));
+		/* Start Rx, unless it is running or every buffer is waiting to be framed */
+		if(!usb_rx_armed && ((usb_rx_desc_tail - usb_rx_desc_head) < USB_RX_NUM_BUFS)){
+			usb_rx_arm();
+		}
 	}
 
 	/* No error. */
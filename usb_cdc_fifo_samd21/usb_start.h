@@ -17,19 +17,50 @@ extern "C" {
 #include "cmd_fifo.h"
 
 // Defines
-#define RX_BUFFER_SIZE		FIFO_MAX_CMD_SIZE			///< pre-processor directive for max size of usb rx buffer in bytes
+#define RX_MAX_LINE_SIZE	FIFO_MAX_CMD_SIZE			///< longest command line in bytes, longer lines are discarded and answered with an error
+#define USB_RX_NUM_BUFS		4							///< number of receive buffers the read endpoint cycles through, must be a power of two
+#define USB_RX_FLOW_CONTROL	1							///< 1 NAKs the host while the command lanes are full, 0 drops the command instead
+#define SWAR_REPEAT_BYTE(c)		(0x01010101UL * (uint8_t)(c))						///< copies a byte into all 4 bytes of a word
+#define SWAR_HAS_ZERO_BYTE(w)	(((w) - 0x01010101UL) & ~(w) & 0x80808080UL)		///< non-zero if any byte of the word is zero
 
-/// @brief struct containing buffer and buffer index
+#if RX_MAX_LINE_SIZE > FIFO_MAX_CMD_SIZE
+#error "RX_MAX_LINE_SIZE must fit in a command FIFO item"
+#endif
+
+/// @brief  enum containing the states of the receive line framer
+enum _usb_rx_states {
+	USB_RX_IDLE,			///< between lines, the next character starts a command
+	USB_RX_LINE,			///< building a command in a slot reserved in a command lane
+	USB_RX_OVERFLOW,		///< line is too long, its error is in the slot and the rest of the line is discarded
+	USB_RX_DROP,			///< no lane had room, the rest of the line is dropped (no flow control only)
+};
+
+typedef enum _usb_rx_states usb_rx_state_t;		///< typedef enum for user access to the receive line framer states
+
+/// @brief struct containing the command being received and its index. The command may span
+/// any number of USB packets.
 struct _config_usb_buffer{
-	uint8_t rx[RX_BUFFER_SIZE];
+	uint8_t *rx;			///< slot reserved in the command FIFO, valid in USB_RX_LINE and USB_RX_OVERFLOW
 	uint8_t rx_idx;
+	fifo_lane_t lane;		///< lane the slot was reserved in
+	usb_rx_state_t state;	///< state of the line framer
 };
 
 typedef struct _config_usb_buffer usb_buffer_t;			///< typedef struct for user access to possible usb command buffer
 
+/// @brief struct describing a received buffer waiting to be framed by the main loop
+struct _config_usb_rx_desc{
+	const uint8_t *buf;		///< received packet, word aligned
+	uint32_t len;			///< number of bytes received
+	uint32_t stamp;			///< irq_cycles_now when the packet was received
+};
+
+typedef struct _config_usb_rx_desc usb_rx_desc_t;		///< typedef struct for user access to the receive descriptors
+
 void cdcd_acm_example(void);
 void cdc_device_acm_init(void);
 void cdcd_acm_register_callback(void);
+bool usb_rx_task(void);
 
 /**
  * \berif Initialize USB